@@ -4,8 +4,8 @@
  *** The abstract AST classes - never used directly. ***
  *******************************************************/
 
-int ast_node::indent_level = 0;
-bool ast_node::branches[10000];
+thread_local int ast_node::indent_level = 0;
+thread_local bool ast_node::branches[10000];
 
 /* The superclass ast_node. */
 ast_node::ast_node(position_information *p)
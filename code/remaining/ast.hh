@@ -153,8 +153,8 @@ class quad_list;
 class ast_node {
 protected:
     // Used for AST printing.
-    static int indent_level;
-    static bool branches[10000];
+    static thread_local int indent_level;
+    static thread_local bool branches[10000];
 
     // All these methods are concerned with printing the AST.
     void indent(ostream &);
@@ -248,6 +248,14 @@ public:
 
     virtual sym_index generate_quads(quad_list &) = 0;
 
+    /*! Generate quads for the expression used as a condition. Control jumps
+     * to the label if the value of the expression equals the truth value
+     * given as the last argument, and falls through otherwise. The default
+     * evaluates the expression and tests the result; and, or and not lower
+     * directly to branches so that operands are only evaluated when needed.
+     */
+    virtual void generate_branch(quad_list &, int, bool);
+
     // Used for safe downcasting. We could provide a mechanism to safely
     // downcast ALL ast nodes... But these ones are the only ones we'll need
     // in this lab course. They will be used during AST optimization.
@@ -1014,6 +1022,8 @@ public:
 
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
+
+    virtual void generate_branch(quad_list &, int, bool);
 };
 
 /*! An integer node. Represents an integer number, like ``5``. */
@@ -1037,6 +1047,8 @@ public:
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
 
+    virtual void generate_branch(quad_list &, int, bool);
+
     // Safe downcasting.
     virtual ast_integer *get_ast_integer() {
         return this;
@@ -1246,6 +1258,8 @@ public:
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
 
+    virtual void generate_branch(quad_list &, int, bool);
+
     // Safe downcasts.
     virtual ast_or *get_ast_binaryoperation() {
         return this;
@@ -1267,6 +1281,8 @@ public:
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
 
+    virtual void generate_branch(quad_list &, int, bool);
+
     // Safe downcasts.
     virtual ast_and *get_ast_binaryoperation() {
         return this;
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <algorithm>
+
+#include "symtab.hh"
+#include "cfg.hh"
+#include "codegen.hh"
+#include "callgraph.hh"
+
+using namespace std;
+
+// Used in parser.y when the -w flag was given. Set by
+// compilation_context::activate().
+thread_local call_graph *program_graph = NULL;
+
+void call_graph::add(symbol *proc, quad_list *q) {
+    node &n = nodes[proc];
+    n.quads = q;
+    order.push_back(proc);
+
+    quad_list_iterator it(q);
+    for (quadruple *quad = it.get_current(); quad != NULL; quad = it.get_next()) {
+        if (!quad_is_call(quad)) {
+            continue;
+        }
+        symbol *callee = sym_tab->get_symbol(quad->sym1);
+        if (find(n.callees.begin(), n.callees.end(), callee) != n.callees.end()) {
+            continue;
+        }
+        n.callees.push_back(callee);
+        nodes[callee].callers.push_back(proc);
+    }
+}
+
+const vector<symbol *> &call_graph::blocks() {
+    return order;
+}
+
+quad_list *call_graph::quads_of(symbol *proc) {
+    return nodes[proc].quads;
+}
+
+const vector<symbol *> &call_graph::callees(symbol *proc) {
+    return nodes[proc].callees;
+}
+
+const vector<symbol *> &call_graph::callers(symbol *proc) {
+    return nodes[proc].callers;
+}
+
+set<symbol *> call_graph::reachable(symbol *root) {
+    set<symbol *> result;
+    vector<symbol *> worklist(1, root);
+    result.insert(root);
+
+    while (!worklist.empty()) {
+        symbol *proc = worklist.back();
+        worklist.pop_back();
+        const vector<symbol *> &calls = callees(proc);
+        for (size_t i = 0; i < calls.size(); i++) {
+            if (result.insert(calls[i]).second) {
+                worklist.push_back(calls[i]);
+            }
+        }
+    }
+    return result;
+}
+
+void call_graph::generate_assembler(symbol *main_env) {
+    set<symbol *> live = reachable(main_env);
+
+    for (size_t i = 0; i < order.size(); i++) {
+        symbol *proc = order[i];
+        const char *kind = proc->tag == SYM_FUNC ? "function" : "procedure";
+        const char *name = sym_tab->pool_lookup(proc->id);
+
+        if (live.find(proc) == live.end()) {
+            cout << "Leaving out " << kind << " \"" << name
+                 << "\", it is never called" << endl;
+            continue;
+        }
+        if (proc == main_env) {
+            cout << "Generating assembler, global level" << endl;
+        } else {
+            cout << "Generating assembler for " << kind << " \"" << name
+                 << "\"" << endl;
+        }
+        code_gen->generate_assembler(nodes[proc].quads, proc);
+    }
+}
+
+/* Prints one line per block, listing what it calls. */
+ostream &operator<<(ostream &o, call_graph *graph) {
+    for (size_t i = 0; i < graph->order.size(); i++) {
+        symbol *proc = graph->order[i];
+        const vector<symbol *> &calls = graph->callees(proc);
+
+        o << "    " << sym_tab->pool_lookup(proc->id) << ":";
+        for (size_t j = 0; j < calls.size(); j++) {
+            o << " " << sym_tab->pool_lookup(calls[j]->id);
+        }
+        o << endl;
+    }
+    return o;
+}
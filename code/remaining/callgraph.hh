@@ -0,0 +1,62 @@
+#ifndef __CALLGRAPH_HH__
+#define __CALLGRAPH_HH__
+
+#include <vector>
+#include <map>
+#include <set>
+
+#include "quads.hh"
+
+using namespace std;
+
+/* The call graph of the whole program. In whole-program mode (the -w flag)
+   a block isn't translated to assembler as soon as it has been parsed, but
+   is added here together with its optimized quads. When the main program
+   has been added too, only the blocks it can reach through calls are
+   translated. The graph is also meant for passes that need to see more
+   than one block at a time. */
+class call_graph {
+private:
+    struct node {
+        quad_list *quads;
+        vector<symbol *> callees;
+        vector<symbol *> callers;
+
+        node()
+            : quads(NULL) {
+        }
+    };
+
+    map<symbol *, node> nodes;
+
+    // The blocks with quads, in the order they were added.
+    vector<symbol *> order;
+
+public:
+    //! Add a block and its quads. The calls are read off the quads.
+    void add(symbol *, quad_list *);
+
+    //! The blocks added so far, in the order they were added. Since a block
+    //! is added when it has been parsed, the main program comes last.
+    const vector<symbol *> &blocks();
+
+    //! The quads of a block, or NULL for the predefined procedures.
+    quad_list *quads_of(symbol *);
+
+    //! The procedures a block calls, and the blocks calling a procedure.
+    const vector<symbol *> &callees(symbol *);
+    const vector<symbol *> &callers(symbol *);
+
+    //! All procedures that can be reached from a block, including itself.
+    set<symbol *> reachable(symbol *);
+
+    //! Generate assembler for the blocks reachable from the main program,
+    //! given as the argument, in the order they were added.
+    void generate_assembler(symbol *);
+
+    friend ostream &operator<<(ostream &, call_graph *);
+};
+
+extern thread_local call_graph *program_graph;
+
+#endif
@@ -0,0 +1,987 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "symtab.hh"
+#include "cfg.hh"
+
+using namespace std;
+
+/*******************
+ *** BIT VECTORS ***
+ *******************/
+
+static const int WORD_BITS = 8 * sizeof(unsigned long);
+
+bit_vector::bit_vector()
+    : nr_bits(0) {
+}
+
+bit_vector::bit_vector(int n, bool value)
+    : words((n + WORD_BITS - 1) / WORD_BITS, value ? ~0UL : 0UL)
+    , nr_bits(n) {
+}
+
+bool bit_vector::test(int i) const {
+    return (words[i / WORD_BITS] >> (i % WORD_BITS)) & 1UL;
+}
+
+void bit_vector::set(int i) {
+    words[i / WORD_BITS] |= 1UL << (i % WORD_BITS);
+}
+
+void bit_vector::reset(int i) {
+    words[i / WORD_BITS] &= ~(1UL << (i % WORD_BITS));
+}
+
+void bit_vector::fill(bool value) {
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] = value ? ~0UL : 0UL;
+    }
+}
+
+bool bit_vector::union_with(const bit_vector &other) {
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); i++) {
+        unsigned long w = words[i] | other.words[i];
+        changed = changed || w != words[i];
+        words[i] = w;
+    }
+    return changed;
+}
+
+bool bit_vector::intersect_with(const bit_vector &other) {
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); i++) {
+        unsigned long w = words[i] & other.words[i];
+        changed = changed || w != words[i];
+        words[i] = w;
+    }
+    return changed;
+}
+
+bool bit_vector::subtract(const bit_vector &other) {
+    bool changed = false;
+    for (size_t i = 0; i < words.size(); i++) {
+        unsigned long w = words[i] & ~other.words[i];
+        changed = changed || w != words[i];
+        words[i] = w;
+    }
+    return changed;
+}
+
+/* Bits beyond nr_bits may differ when a vector was filled, so only compare
+   the ones in use. */
+bool bit_vector::operator==(const bit_vector &other) const {
+    if (nr_bits != other.nr_bits) {
+        return false;
+    }
+    for (int i = 0; i < nr_bits; i++) {
+        if (test(i) != other.test(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/***************************************
+ *** WHAT THE QUADS DO TO THEIR ARGS ***
+ ***************************************/
+
+sym_index quad_definition(quadruple *q) {
+    switch (q->op_code) {
+    case q_rload:
+    case q_iload:
+    case q_inot:
+    case q_ruminus:
+    case q_iuminus:
+    case q_rplus:
+    case q_iplus:
+    case q_rminus:
+    case q_iminus:
+    case q_ior:
+    case q_iand:
+    case q_rmult:
+    case q_imult:
+    case q_rdivide:
+    case q_idivide:
+    case q_imod:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+    case q_rlt:
+    case q_ilt:
+    case q_rgt:
+    case q_igt:
+    case q_rassign:
+    case q_iassign:
+    case q_call:
+    case q_lindex:
+    case q_rrindex:
+    case q_irindex:
+    case q_rfetch:
+    case q_ifetch:
+    case q_itor:
+        return q->sym3;
+    default:
+        return NULL_SYM;
+    }
+}
+
+int quad_operands(quadruple *q, sym_index ops[3]) {
+    switch (q->op_code) {
+    case q_inot:
+    case q_ruminus:
+    case q_iuminus:
+    case q_rassign:
+    case q_iassign:
+    case q_itor:
+    case q_rfetch:
+    case q_ifetch:
+    case q_param:
+        ops[0] = q->sym1;
+        return 1;
+    case q_rplus:
+    case q_iplus:
+    case q_rminus:
+    case q_iminus:
+    case q_ior:
+    case q_iand:
+    case q_rmult:
+    case q_imult:
+    case q_rdivide:
+    case q_idivide:
+    case q_imod:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+    case q_rlt:
+    case q_ilt:
+    case q_rgt:
+    case q_igt:
+    case q_lindex:
+    case q_rrindex:
+    case q_irindex:
+        ops[0] = q->sym1;
+        ops[1] = q->sym2;
+        return 2;
+    case q_rstore:
+    case q_istore:
+        ops[0] = q->sym1;
+        ops[1] = q->sym3;
+        return 2;
+    case q_rreturn:
+    case q_ireturn:
+    case q_jmpf:
+    case q_jmpt:
+        ops[0] = q->sym2;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+bool quad_is_pure(quadruple *q) {
+    switch (q->op_code) {
+    case q_call:
+    case q_rrindex:
+    case q_irindex:
+    case q_rfetch:
+    case q_ifetch:
+        return false;
+    default:
+        return quad_definition(q) != NULL_SYM;
+    }
+}
+
+bool quad_reads_memory(quadruple *q) {
+    switch (q->op_code) {
+    case q_rrindex:
+    case q_irindex:
+    case q_rfetch:
+    case q_ifetch:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* A called procedure may store into any array it can see, so calls count as
+   memory writes as well. */
+bool quad_writes_memory(quadruple *q) {
+    return q->op_code == q_rstore || q->op_code == q_istore || quad_is_call(q);
+}
+
+bool quad_is_call(quadruple *q) {
+    return q->op_code == q_call || q->op_code == q_tcall;
+}
+
+bool quad_is_jump(quadruple *q) {
+    switch (q->op_code) {
+    case q_jmp:
+    case q_jmpf:
+    case q_jmpt:
+    case q_rreturn:
+    case q_ireturn:
+    case q_tcall:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* The label a jump quad goes to. A tail call ends the procedure, so as far
+   as the graph is concerned it jumps to the end like a return does. */
+int quad_jump_target(quadruple *q) {
+    return q->op_code == q_tcall ? q->int3 : q->int1;
+}
+
+/****************************
+ *** BLOCKS AND THE GRAPH ***
+ ****************************/
+
+basic_block::basic_block(int n)
+    : nr(n)
+    , label(-1)
+    , idom(NULL)
+    , rpo_nr(-1)
+    , loop_depth(0)
+    , loop(NULL) {
+}
+
+quadruple *basic_block::last_quad() {
+    if (quads.empty()) {
+        return NULL;
+    }
+    return quads.back();
+}
+
+natural_loop::natural_loop(basic_block *h, int nr_blocks)
+    : header(h)
+    , contains(nr_blocks, false)
+    , parent(NULL)
+    , depth(1) {
+}
+
+control_flow_graph::control_flow_graph(quad_list *q, symbol *e)
+    : env(e)
+    , last_label(q->last_label) {
+    build_blocks(q);
+    build_edges();
+    compute_dominators();
+    find_loops();
+    number_variables();
+}
+
+control_flow_graph::~control_flow_graph() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        delete blocks[i];
+    }
+    for (size_t i = 0; i < loops.size(); i++) {
+        delete loops[i];
+    }
+}
+
+/* A new block starts at every label (unless the current block holds nothing
+   but labels so far) and after every jump. */
+void control_flow_graph::build_blocks(quad_list *q_list) {
+    basic_block *current = new basic_block(0);
+    blocks.push_back(current);
+
+    for (quad_list_element *e = q_list->head; e != NULL; e = e->next) {
+        quadruple *q = e->data;
+
+        if (q->op_code == q_labl) {
+            bool only_labels = true;
+            for (size_t i = 0; i < current->quads.size(); i++) {
+                if (current->quads[i]->op_code != q_labl) {
+                    only_labels = false;
+                }
+            }
+            if (!only_labels) {
+                current = new basic_block(blocks.size());
+                blocks.push_back(current);
+            }
+            if (current->label == -1) {
+                current->label = q->int1;
+            }
+            label_blocks[q->int1] = current;
+        }
+
+        current->quads.push_back(q);
+
+        if (quad_is_jump(q) && e->next != NULL) {
+            current = new basic_block(blocks.size());
+            blocks.push_back(current);
+        }
+    }
+}
+
+static void add_edge(basic_block *from, basic_block *to) {
+    if (find(from->succs.begin(), from->succs.end(), to) == from->succs.end()) {
+        from->succs.push_back(to);
+        to->preds.push_back(from);
+    }
+}
+
+void control_flow_graph::build_edges() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        basic_block *b = blocks[i];
+        basic_block *next = i + 1 < blocks.size() ? blocks[i + 1] : NULL;
+        quadruple *last = b->last_quad();
+
+        if (last == NULL || !quad_is_jump(last)) {
+            if (next != NULL) {
+                add_edge(b, next);
+            }
+            continue;
+        }
+
+        basic_block *target = block_for_label(quad_jump_target(last));
+        if (target == NULL) {
+            fatal("control_flow_graph: jump to an unknown label");
+        }
+        add_edge(b, target);
+        if ((last->op_code == q_jmpf || last->op_code == q_jmpt) && next != NULL) {
+            add_edge(b, next);
+        }
+    }
+}
+
+/* Dominators are computed with the iterative algorithm of Cooper, Harvey and
+   Kennedy, which works on the reverse postorder and only needs the idom
+   links. */
+static basic_block *intersect(basic_block *a, basic_block *b) {
+    while (a != b) {
+        while (a->rpo_nr > b->rpo_nr) {
+            a = a->idom;
+        }
+        while (b->rpo_nr > a->rpo_nr) {
+            b = b->idom;
+        }
+    }
+    return a;
+}
+
+void control_flow_graph::compute_dominators() {
+    // Depth first search for the postorder, without recursion since the
+    // graphs of large procedures can be deep.
+    vector<bool> visited(blocks.size(), false);
+    vector<pair<basic_block *, size_t> > stack;
+    vector<basic_block *> postorder;
+
+    stack.push_back(make_pair(blocks[0], (size_t)0));
+    visited[0] = true;
+    while (!stack.empty()) {
+        basic_block *b = stack.back().first;
+        size_t &next_succ = stack.back().second;
+        if (next_succ < b->succs.size()) {
+            basic_block *s = b->succs[next_succ++];
+            if (!visited[s->nr]) {
+                visited[s->nr] = true;
+                stack.push_back(make_pair(s, (size_t)0));
+            }
+        } else {
+            postorder.push_back(b);
+            stack.pop_back();
+        }
+    }
+
+    rpo.assign(postorder.rbegin(), postorder.rend());
+    for (size_t i = 0; i < rpo.size(); i++) {
+        rpo[i]->rpo_nr = i;
+    }
+
+    basic_block *entry = blocks[0];
+    entry->idom = entry;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < rpo.size(); i++) {
+            basic_block *b = rpo[i];
+            basic_block *new_idom = NULL;
+            for (size_t j = 0; j < b->preds.size(); j++) {
+                basic_block *p = b->preds[j];
+                if (p->idom == NULL) {
+                    continue;
+                }
+                new_idom = new_idom == NULL ? p : intersect(p, new_idom);
+            }
+            if (b->idom != new_idom) {
+                b->idom = new_idom;
+                changed = true;
+            }
+        }
+    }
+    // The entry has no dominator but itself; keep the field NULL as
+    // documented so walks up the tree terminate.
+    entry->idom = NULL;
+}
+
+bool control_flow_graph::dominates(basic_block *a, basic_block *b) {
+    if (a->rpo_nr < 0 || b->rpo_nr < 0) {
+        return false;
+    }
+    while (b != NULL) {
+        if (a == b) {
+            return true;
+        }
+        b = b->idom;
+    }
+    return false;
+}
+
+static bool bigger_loop(natural_loop *a, natural_loop *b) {
+    return a->blocks.size() > b->blocks.size();
+}
+
+/* A back edge is an edge whose target dominates its source. The loop of a
+   back edge is the header plus every block that can reach the source
+   without passing through the header. */
+void control_flow_graph::find_loops() {
+    map<basic_block *, natural_loop *> by_header;
+
+    for (size_t i = 0; i < rpo.size(); i++) {
+        basic_block *b = rpo[i];
+        for (size_t j = 0; j < b->succs.size(); j++) {
+            basic_block *h = b->succs[j];
+            if (!dominates(h, b)) {
+                continue;
+            }
+
+            natural_loop *loop = by_header[h];
+            if (loop == NULL) {
+                loop = new natural_loop(h, blocks.size());
+                loop->contains[h->nr] = true;
+                loop->blocks.push_back(h);
+                by_header[h] = loop;
+                loops.push_back(loop);
+            }
+            loop->latches.push_back(b);
+
+            vector<basic_block *> work;
+            work.push_back(b);
+            while (!work.empty()) {
+                basic_block *x = work.back();
+                work.pop_back();
+                if (loop->contains[x->nr]) {
+                    continue;
+                }
+                loop->contains[x->nr] = true;
+                loop->blocks.push_back(x);
+                for (size_t k = 0; k < x->preds.size(); k++) {
+                    if (x->preds[k]->rpo_nr >= 0) {
+                        work.push_back(x->preds[k]);
+                    }
+                }
+            }
+        }
+    }
+
+    // Natural loops with different headers are either nested or disjoint,
+    // so the parent of a loop is the smallest bigger loop holding its header.
+    stable_sort(loops.begin(), loops.end(), bigger_loop);
+    for (size_t i = 0; i < loops.size(); i++) {
+        natural_loop *loop = loops[i];
+        for (size_t j = 0; j < i; j++) {
+            if (loops[j]->contains[loop->header->nr]) {
+                loop->parent = loops[j];
+            }
+        }
+        if (loop->parent != NULL) {
+            loop->depth = loop->parent->depth + 1;
+        }
+        for (size_t j = 0; j < loop->blocks.size(); j++) {
+            basic_block *b = loop->blocks[j];
+            b->loop_depth++;
+            if (b->loop == NULL || b->loop->depth < loop->depth) {
+                b->loop = loop;
+            }
+        }
+    }
+}
+
+void control_flow_graph::number_variables() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        for (size_t j = 0; j < blocks[i]->quads.size(); j++) {
+            quadruple *q = blocks[i]->quads[j];
+            sym_index syms[4];
+            int n = quad_operands(q, syms);
+            syms[n++] = quad_definition(q);
+
+            for (int k = 0; k < n; k++) {
+                sym_type tag = sym_tab->get_symbol_tag(syms[k]);
+                if ((tag == SYM_VAR || tag == SYM_PARAM) &&
+                    var_numbers.find(syms[k]) == var_numbers.end()) {
+                    var_numbers[syms[k]] = variables.size();
+                    variables.push_back(syms[k]);
+                }
+            }
+        }
+    }
+}
+
+basic_block *control_flow_graph::block_for_label(int label) {
+    map<int, basic_block *>::iterator it = label_blocks.find(label);
+    if (it == label_blocks.end()) {
+        return NULL;
+    }
+    return it->second;
+}
+
+int control_flow_graph::var_nr(sym_index sym_p) {
+    map<sym_index, int>::iterator it = var_numbers.find(sym_p);
+    if (it == var_numbers.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+bool control_flow_graph::is_local(sym_index sym_p) {
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    return (sym->tag == SYM_VAR || sym->tag == SYM_PARAM || sym->tag == SYM_ARRAY) &&
+           sym->level == env->level + 1;
+}
+
+bool control_flow_graph::call_may_access(quadruple *call, sym_index sym_p) {
+    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+    if ((tag != SYM_VAR && tag != SYM_PARAM && tag != SYM_ARRAY) ||
+        sym_tab->is_temp_var(sym_p)) {
+        return false;
+    }
+
+    symbol *callee = sym_tab->get_symbol(call->sym1);
+    if (summaries->known(callee)) {
+        return summaries->may_access(callee, sym_p);
+    }
+    if (!is_local(sym_p)) {
+        return true;
+    }
+    return callee->level == env->level + 1;
+}
+
+bool control_flow_graph::call_may_write_memory(quadruple *call) {
+    symbol *callee = sym_tab->get_symbol(call->sym1);
+    if (!summaries->known(callee)) {
+        return true;
+    }
+    return summaries->accesses_arrays(callee);
+}
+
+void control_flow_graph::write_back(quad_list *q_list) {
+    quad_list_element *e = q_list->head;
+    while (e != NULL) {
+        quad_list_element *next = e->next;
+        delete e;
+        e = next;
+    }
+    q_list->head = NULL;
+    q_list->tail = NULL;
+
+    for (size_t i = 0; i < blocks.size(); i++) {
+        for (size_t j = 0; j < blocks[i]->quads.size(); j++) {
+            (*q_list) += blocks[i]->quads[j];
+        }
+    }
+}
+
+/* Procedure summaries. Set by compilation_context::activate(). */
+thread_local call_summaries *summaries = NULL;
+
+void call_summaries::record(control_flow_graph *cfg) {
+    set<sym_index> result;
+
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        for (size_t j = 0; j < cfg->blocks[i]->quads.size(); j++) {
+            quadruple *q = cfg->blocks[i]->quads[j];
+            sym_index syms[4];
+            int n = quad_operands(q, syms);
+            syms[n++] = quad_definition(q);
+
+            for (int k = 0; k < n; k++) {
+                sym_type tag = sym_tab->get_symbol_tag(syms[k]);
+                if ((tag == SYM_VAR || tag == SYM_PARAM || tag == SYM_ARRAY) &&
+                    !cfg->is_local(syms[k]) && !sym_tab->is_temp_var(syms[k])) {
+                    result.insert(syms[k]);
+                }
+            }
+
+            if (!quad_is_call(q)) {
+                continue;
+            }
+            symbol *callee = sym_tab->get_symbol(q->sym1);
+            if (callee == cfg->env) {
+                // Recursion adds nothing new.
+                continue;
+            }
+            if (!known(callee)) {
+                return;
+            }
+            map<symbol *, set<sym_index> >::iterator it = accessed.find(callee);
+            if (it == accessed.end()) {
+                continue;
+            }
+            for (set<sym_index>::iterator v = it->second.begin();
+                 v != it->second.end(); v++) {
+                if (!cfg->is_local(*v)) {
+                    result.insert(*v);
+                }
+            }
+        }
+    }
+
+    accessed[cfg->env] = result;
+}
+
+bool call_summaries::known(symbol *proc) {
+    return proc->level == 0 || accessed.find(proc) != accessed.end();
+}
+
+bool call_summaries::may_access(symbol *proc, sym_index sym_p) {
+    map<symbol *, set<sym_index> >::iterator it = accessed.find(proc);
+    if (it == accessed.end()) {
+        return proc->level != 0;
+    }
+    return it->second.find(sym_p) != it->second.end();
+}
+
+bool call_summaries::accesses_arrays(symbol *proc) {
+    map<symbol *, set<sym_index> >::iterator it = accessed.find(proc);
+    if (it == accessed.end()) {
+        return proc->level != 0;
+    }
+    for (set<sym_index>::iterator v = it->second.begin(); v != it->second.end(); v++) {
+        if (sym_tab->get_symbol_tag(*v) == SYM_ARRAY) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void print_block_list(ostream &o, const vector<basic_block *> &list) {
+    for (size_t i = 0; i < list.size(); i++) {
+        o << " B" << list[i]->nr;
+    }
+}
+
+/* Prints the members of a set, each as the prefix and its number. */
+static void print_set(ostream &o, const bit_vector &set, const char *prefix) {
+    for (int i = 0; i < set.size(); i++) {
+        if (set.test(i)) {
+            o << " " << prefix << i;
+        }
+    }
+}
+
+/* Every block is printed with the results of the dataflow problems at its
+   top. The definitions and expressions they refer to are listed after the
+   blocks. */
+void control_flow_graph::print(ostream &o) {
+    liveness_analysis live(this);
+    reaching_definitions reaching(this);
+    available_expressions available(this);
+
+    o << short_symbols;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        basic_block *b = blocks[i];
+        o << "  Block B" << b->nr;
+        if (b->rpo_nr < 0) {
+            o << " (unreachable)";
+        }
+        o << "\n    preds:";
+        print_block_list(o, b->preds);
+        o << "\n    succs:";
+        print_block_list(o, b->succs);
+        if (b->idom != NULL) {
+            o << "\n    idom: B" << b->idom->nr;
+        }
+        if (b->loop != NULL) {
+            o << "\n    loop depth " << b->loop_depth
+              << ", header B" << b->loop->header->nr;
+        }
+        o << "\n    live in:";
+        for (size_t j = 0; j < variables.size(); j++) {
+            if (live.in[b->nr].test(j)) {
+                o << " " << sym_tab->get_symbol(variables[j]);
+            }
+        }
+        o << "\n    reaching in:";
+        print_set(o, reaching.in[b->nr], "D");
+        o << "\n    available in:";
+        print_set(o, available.in[b->nr], "E");
+        o << endl;
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            o << "    " << b->quads[j] << endl;
+        }
+    }
+    for (size_t i = 0; i < loops.size(); i++) {
+        natural_loop *loop = loops[i];
+        o << "  Loop at B" << loop->header->nr << ", depth " << loop->depth
+          << ", blocks:";
+        print_block_list(o, loop->blocks);
+        o << endl;
+    }
+    for (size_t i = 0; i < reaching.definitions.size(); i++) {
+        o << "  D" << i << ": " << reaching.definitions[i] << endl;
+    }
+    for (size_t i = 0; i < available.expressions.size(); i++) {
+        o << "  E" << i << ": " << available.expressions[i] << endl;
+    }
+    o << long_symbols;
+}
+
+ostream &operator<<(ostream &o, control_flow_graph *cfg) {
+    cfg->print(o);
+    return o;
+}
+
+/******************************
+ *** THE DATAFLOW FRAMEWORK ***
+ ******************************/
+
+dataflow_problem::dataflow_problem(control_flow_graph *g, int n, bool fwd, bool union_meet)
+    : cfg(g)
+    , universe(n)
+    , forward(fwd)
+    , may(union_meet) {
+}
+
+bit_vector dataflow_problem::boundary() {
+    return bit_vector(universe, false);
+}
+
+void dataflow_problem::transfer_block(basic_block *b, bit_vector &set) {
+    if (forward) {
+        for (size_t i = 0; i < b->quads.size(); i++) {
+            transfer(b->quads[i], set);
+        }
+    } else {
+        for (size_t i = b->quads.size(); i > 0; i--) {
+            transfer(b->quads[i - 1], set);
+        }
+    }
+}
+
+/* Round robin iteration in reverse postorder (or its reverse for backward
+   problems) until a fixed point is reached. Unreachable blocks are left out
+   of the meets. May problems start from the empty set, must problems from
+   the full one. */
+void dataflow_problem::solve() {
+    size_t n = cfg->blocks.size();
+    in.assign(n, bit_vector(universe, !may));
+    out.assign(n, bit_vector(universe, !may));
+
+    bit_vector edge = boundary();
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < cfg->rpo.size(); i++) {
+            basic_block *b = cfg->rpo[forward ? i : cfg->rpo.size() - 1 - i];
+            bit_vector set(universe, !may);
+
+            if (forward) {
+                bool first = true;
+                if (b == cfg->blocks[0]) {
+                    set = edge;
+                    first = false;
+                }
+                for (size_t j = 0; j < b->preds.size(); j++) {
+                    basic_block *p = b->preds[j];
+                    if (p->rpo_nr < 0) {
+                        continue;
+                    }
+                    if (first) {
+                        set = out[p->nr];
+                        first = false;
+                    } else if (may) {
+                        set.union_with(out[p->nr]);
+                    } else {
+                        set.intersect_with(out[p->nr]);
+                    }
+                }
+                in[b->nr] = set;
+                transfer_block(b, set);
+                if (set != out[b->nr]) {
+                    out[b->nr] = set;
+                    changed = true;
+                }
+            } else {
+                if (b->succs.empty()) {
+                    set = edge;
+                }
+                for (size_t j = 0; j < b->succs.size(); j++) {
+                    if (j == 0) {
+                        set = in[b->succs[j]->nr];
+                    } else if (may) {
+                        set.union_with(in[b->succs[j]->nr]);
+                    } else {
+                        set.intersect_with(in[b->succs[j]->nr]);
+                    }
+                }
+                out[b->nr] = set;
+                transfer_block(b, set);
+                if (set != in[b->nr]) {
+                    in[b->nr] = set;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+/* Liveness. */
+liveness_analysis::liveness_analysis(control_flow_graph *g)
+    : dataflow_problem(g, g->variables.size(), false, true) {
+    solve();
+}
+
+bit_vector liveness_analysis::boundary() {
+    bit_vector set(universe, false);
+    for (int i = 0; i < universe; i++) {
+        sym_index v = cfg->variables[i];
+        if (!cfg->is_local(v) && !sym_tab->is_temp_var(v)) {
+            set.set(i);
+        }
+    }
+    return set;
+}
+
+void liveness_analysis::transfer(quadruple *q, bit_vector &set) {
+    int def = cfg->var_nr(quad_definition(q));
+    if (def >= 0) {
+        set.reset(def);
+    }
+
+    if (quad_is_call(q)) {
+        for (int i = 0; i < universe; i++) {
+            if (cfg->call_may_access(q, cfg->variables[i])) {
+                set.set(i);
+            }
+        }
+    }
+
+    sym_index ops[3];
+    int n = quad_operands(q, ops);
+    for (int i = 0; i < n; i++) {
+        int use = cfg->var_nr(ops[i]);
+        if (use >= 0) {
+            set.set(use);
+        }
+    }
+}
+
+/* Reaching definitions. A definite definition of a variable kills the other
+   definite definitions of it. Since a call only may write a variable, it
+   neither kills anything but its own result nor is killed by later writes,
+   which errs on the safe side. */
+reaching_definitions::reaching_definitions(control_flow_graph *g)
+    : dataflow_problem(g, 0, true, true) {
+    for (size_t i = 0; i < g->blocks.size(); i++) {
+        for (size_t j = 0; j < g->blocks[i]->quads.size(); j++) {
+            quadruple *q = g->blocks[i]->quads[j];
+            if (quad_definition(q) != NULL_SYM || quad_is_call(q)) {
+                def_numbers[q] = definitions.size();
+                definitions.push_back(q);
+            }
+        }
+    }
+    universe = definitions.size();
+    solve();
+}
+
+bool reaching_definitions::defines(int d, sym_index sym_p) {
+    quadruple *q = definitions[d];
+    if (quad_definition(q) == sym_p) {
+        return true;
+    }
+    return quad_is_call(q) && cfg->call_may_access(q, sym_p);
+}
+
+void reaching_definitions::transfer(quadruple *q, bit_vector &set) {
+    map<quadruple *, int>::iterator it = def_numbers.find(q);
+    if (it == def_numbers.end()) {
+        return;
+    }
+
+    sym_index v = quad_definition(q);
+    if (v != NULL_SYM) {
+        for (int d = 0; d < universe; d++) {
+            if (quad_definition(definitions[d]) == v) {
+                set.reset(d);
+            }
+        }
+    }
+    set.set(it->second);
+}
+
+/* Available expressions. */
+vector<long> available_expressions::expression_key(quadruple *q) {
+    vector<long> key;
+    if ((!quad_is_pure(q) && !quad_reads_memory(q)) ||
+        q->op_code == q_rassign || q->op_code == q_iassign) {
+        return key;
+    }
+    key.push_back(q->op_code);
+    key.push_back(q->sym1);
+    key.push_back(q->sym2);
+    return key;
+}
+
+available_expressions::available_expressions(control_flow_graph *g)
+    : dataflow_problem(g, 0, true, false) {
+    for (size_t i = 0; i < g->blocks.size(); i++) {
+        for (size_t j = 0; j < g->blocks[i]->quads.size(); j++) {
+            quadruple *q = g->blocks[i]->quads[j];
+            vector<long> key = expression_key(q);
+            if (!key.empty() && expr_numbers.find(key) == expr_numbers.end()) {
+                expr_numbers[key] = expressions.size();
+                expressions.push_back(q);
+            }
+        }
+    }
+    universe = expressions.size();
+    solve();
+}
+
+int available_expressions::expression_nr(quadruple *q) {
+    vector<long> key = expression_key(q);
+    if (key.empty()) {
+        return -1;
+    }
+    map<vector<long>, int>::iterator it = expr_numbers.find(key);
+    if (it == expr_numbers.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+void available_expressions::transfer(quadruple *q, bit_vector &set) {
+    int e = expression_nr(q);
+    if (e >= 0) {
+        set.set(e);
+    }
+
+    // Anything computed from the variable just written is stale now, and so
+    // are all array reads after a store or call.
+    sym_index v = quad_definition(q);
+    bool clobbers = quad_is_call(q) ? cfg->call_may_write_memory(q)
+                                    : quad_writes_memory(q);
+    for (int i = 0; i < universe; i++) {
+        quadruple *expr = expressions[i];
+        if (clobbers && quad_reads_memory(expr)) {
+            set.reset(i);
+            continue;
+        }
+
+        sym_index ops[3];
+        int n = quad_operands(expr, ops);
+        for (int j = 0; j < n; j++) {
+            if ((v != NULL_SYM && ops[j] == v) ||
+                (quad_is_call(q) && cfg->call_may_access(q, ops[j]))) {
+                set.reset(i);
+            }
+        }
+    }
+}
@@ -0,0 +1,322 @@
+#ifndef __CFG_HH__
+#define __CFG_HH__
+
+#include <vector>
+#include <map>
+#include <set>
+
+#include "quads.hh"
+
+using namespace std;
+
+/* This file contains the analysis layer the quad optimizations are built on.
+   A procedure's quad list is split into basic blocks, which are linked into
+   a control flow graph. On top of the graph we compute dominators and the
+   natural loops, and provide a small iterative dataflow framework together
+   with the three classical analyses: liveness, reaching definitions and
+   available expressions. */
+
+/* A fixed size set of small integers, stored as a bit vector. Used for the
+   dataflow sets. */
+class bit_vector {
+private:
+    vector<unsigned long> words;
+    int nr_bits;
+
+public:
+    bit_vector();
+    bit_vector(int, bool = false);
+
+    int size() const {
+        return nr_bits;
+    }
+
+    bool test(int) const;
+    void set(int);
+    void reset(int);
+
+    // Set every bit (or clear every bit).
+    void fill(bool);
+
+    // Set operations. They return true if the set changed.
+    bool union_with(const bit_vector &);
+    bool intersect_with(const bit_vector &);
+    bool subtract(const bit_vector &);
+
+    bool operator==(const bit_vector &) const;
+    bool operator!=(const bit_vector &other) const {
+        return !(*this == other);
+    }
+};
+
+class natural_loop;
+
+/* A basic block: a maximal sequence of quads that is only entered at the
+   top and only left at the bottom. A block that starts with a label has the
+   number of that label in 'label' (or -1 if it doesn't). */
+class basic_block {
+public:
+    // Position of the block in control_flow_graph::blocks.
+    int nr;
+
+    // The label starting the block, if any.
+    int label;
+
+    // The quads of the block, in order.
+    vector<quadruple *> quads;
+
+    // Control flow edges.
+    vector<basic_block *> preds;
+    vector<basic_block *> succs;
+
+    // Immediate dominator. NULL for the entry block and unreachable blocks.
+    basic_block *idom;
+
+    // Position in the reverse postorder, or -1 if the block is unreachable.
+    int rpo_nr;
+
+    // Number of loops this block is part of, and the innermost of them.
+    int loop_depth;
+    natural_loop *loop;
+
+    basic_block(int);
+
+    // The last quad of the block, or NULL if it is empty.
+    quadruple *last_quad();
+};
+
+/* A natural loop, identified by its header block. Loops sharing a header
+   are merged into one. */
+class natural_loop {
+public:
+    // The only block through which the loop is entered.
+    basic_block *header;
+
+    // All blocks in the loop, including the header.
+    vector<basic_block *> blocks;
+
+    // Blocks inside the loop that branch back to the header.
+    vector<basic_block *> latches;
+
+    // Membership test, indexed on basic_block::nr.
+    vector<bool> contains;
+
+    // The innermost loop enclosing this one, if any.
+    natural_loop *parent;
+
+    // 1 for outermost loops.
+    int depth;
+
+    natural_loop(basic_block *, int);
+};
+
+/* The control flow graph of a single procedure, function or the main program.
+   The graph is built from a quad list and can be turned back into one with
+   write_back() after the quads in the blocks have been changed. Since the
+   blocks are kept in their original order, falling through from one block
+   to the next means falling through to blocks[nr + 1]. */
+class control_flow_graph {
+private:
+    // Maps a label number to the block it starts.
+    map<int, basic_block *> label_blocks;
+
+    // Maps variables and parameters to dense numbers for the dataflow sets.
+    map<sym_index, int> var_numbers;
+
+    void build_blocks(quad_list *);
+    void build_edges();
+    void compute_dominators();
+    void find_loops();
+    void number_variables();
+
+    void print(ostream &);
+
+public:
+    // The procedure the quad list belongs to.
+    symbol *env;
+
+    // Label ending the quad list. Return quads jump here.
+    int last_label;
+
+    // All the blocks, in the order they appear in the quad list.
+    // blocks[0] is the entry block.
+    vector<basic_block *> blocks;
+
+    // Reachable blocks in reverse postorder.
+    vector<basic_block *> rpo;
+
+    // All natural loops, outer loops before the loops they contain.
+    vector<natural_loop *> loops;
+
+    // The variables and parameters referenced in the quads, in number order.
+    vector<sym_index> variables;
+
+    control_flow_graph(quad_list *, symbol *);
+    ~control_flow_graph();
+
+    // Return the block starting with a given label.
+    basic_block *block_for_label(int);
+
+    // True if the first block dominates the second.
+    bool dominates(basic_block *, basic_block *);
+
+    // Dense number of a variable, or -1 if it isn't a tracked variable.
+    int var_nr(sym_index);
+
+    // True if the symbol is a variable or parameter belonging to env.
+    bool is_local(sym_index);
+
+    // True if the call quad may read or write the given variable. Temporaries
+    // are never touched by calls, locals only by procedures nested in env.
+    // Calls to procedures with a summary only touch what it lists.
+    bool call_may_access(quadruple *, sym_index);
+
+    // True if the call quad may store into an array.
+    bool call_may_write_memory(quadruple *);
+
+    // Replace the contents of a quad list with the quads of the blocks.
+    void write_back(quad_list *);
+
+    friend ostream &operator<<(ostream &, control_flow_graph *);
+};
+
+/* For every procedure compiled (and optimized) so far, the variables and
+   arrays declared outside of it that it, or anything it calls, may read or
+   write. A procedure calling something without a summary, such as an
+   enclosing procedure that isn't finished yet, gets no summary itself. The
+   predefined procedures touch nothing. */
+class call_summaries {
+private:
+    map<symbol *, set<sym_index> > accessed;
+
+public:
+    // Compute and store the summary of cfg->env.
+    void record(control_flow_graph *);
+
+    bool known(symbol *);
+
+    bool may_access(symbol *, sym_index);
+
+    bool accesses_arrays(symbol *);
+};
+
+extern thread_local call_summaries *summaries;
+
+/* Helpers telling what a quad does with its arguments. */
+
+// The symbol a quad assigns to, or NULL_SYM.
+sym_index quad_definition(quadruple *);
+
+// The symbols a quad reads. Returns how many were stored in the array.
+int quad_operands(quadruple *, sym_index[3]);
+
+// True if the quad only computes its result from its operands, ie, it can
+// be removed if the result is unused, or moved as long as its operands are.
+bool quad_is_pure(quadruple *);
+
+// True if the result of the quad depends on the contents of arrays.
+bool quad_reads_memory(quadruple *);
+
+// True if the quad writes to arrays.
+bool quad_writes_memory(quadruple *);
+
+// True if the quad ends a basic block by jumping.
+bool quad_is_jump(quadruple *);
+
+// The label a jumping quad goes to.
+int quad_jump_target(quadruple *);
+
+// True for calls, including tail calls.
+bool quad_is_call(quadruple *);
+
+/* The dataflow framework. A problem is described by its direction, its meet
+   operator, the value at the boundary (the entry or exit of the procedure)
+   and the transfer function of a single quad. solve() iterates over the
+   blocks until nothing changes, leaving the sets at the start and end of
+   each block in 'in' and 'out'. For backward problems 'in' is still the set
+   at the top of the block. */
+class dataflow_problem {
+protected:
+    control_flow_graph *cfg;
+
+    // Number of elements in the sets.
+    int universe;
+
+    bool forward;
+
+    // Meet with union if true, with intersection otherwise.
+    bool may;
+
+    // The set at the entry (forward) or exit (backward) of the procedure.
+    virtual bit_vector boundary();
+
+public:
+    vector<bit_vector> in;
+    vector<bit_vector> out;
+
+    dataflow_problem(control_flow_graph *, int, bool, bool);
+    virtual ~dataflow_problem() {
+    }
+
+    // Apply the effect of a single quad to a set.
+    virtual void transfer(quadruple *, bit_vector &) = 0;
+
+    // Apply the effect of a whole block (in the problem's direction).
+    void transfer_block(basic_block *, bit_vector &);
+
+    void solve();
+};
+
+/* Live variables: bit n is set if cfg->variables[n] may be read before
+   it is written. Nonlocal variables are live at the end of the procedure. */
+class liveness_analysis : public dataflow_problem {
+protected:
+    virtual bit_vector boundary();
+
+public:
+    liveness_analysis(control_flow_graph *);
+
+    virtual void transfer(quadruple *, bit_vector &);
+};
+
+/* Reaching definitions: bit n is set if definitions[n] may reach the point.
+   Calls count as (non-killing) definitions of everything they may write. */
+class reaching_definitions : public dataflow_problem {
+private:
+    map<quadruple *, int> def_numbers;
+
+public:
+    // The quads defining something, in number order.
+    vector<quadruple *> definitions;
+
+    reaching_definitions(control_flow_graph *);
+
+    // True if the definition may assign the variable.
+    bool defines(int, sym_index);
+
+    virtual void transfer(quadruple *, bit_vector &);
+};
+
+/* Available expressions: bit n is set if expressions[n] has been computed
+   on every path to the point and none of its operands (or, for array reads,
+   the contents of memory) have changed since. */
+class available_expressions : public dataflow_problem {
+private:
+    map<vector<long>, int> expr_numbers;
+
+    // The key used to identify equal expressions.
+    vector<long> expression_key(quadruple *);
+
+public:
+    // One representative quad per expression, in number order.
+    vector<quadruple *> expressions;
+
+    available_expressions(control_flow_graph *);
+
+    // The number of the expression a quad computes, or -1.
+    int expression_nr(quadruple *);
+
+    virtual void transfer(quadruple *, bit_vector &);
+};
+
+#endif
@@ -0,0 +1,487 @@
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "codecache.hh"
+
+using namespace std;
+
+/* What each argument of a quad is, per op code, as listed in quads.hh:
+   'i' for an integer (a label, a count or a constant), 's' for a symbol,
+   '-' if unused. */
+static const char *QUAD_ARGUMENTS[] = {
+    "i-s", // q_rload
+    "i-s", // q_iload
+    "s-s", // q_inot
+    "s-s", // q_ruminus
+    "s-s", // q_iuminus
+    "sss", // q_rplus
+    "sss", // q_iplus
+    "sss", // q_rminus
+    "sss", // q_iminus
+    "sss", // q_ior
+    "sss", // q_iand
+    "sss", // q_rmult
+    "sss", // q_imult
+    "sss", // q_rdivide
+    "sss", // q_idivide
+    "sss", // q_imod
+    "sss", // q_req
+    "sss", // q_ieq
+    "sss", // q_rne
+    "sss", // q_ine
+    "sss", // q_rlt
+    "sss", // q_ilt
+    "sss", // q_rgt
+    "sss", // q_igt
+    "s-s", // q_rstore
+    "s-s", // q_istore
+    "s-s", // q_rassign
+    "s-s", // q_iassign
+    "sis", // q_call
+    "sii", // q_tcall
+    "is-", // q_rreturn
+    "is-", // q_ireturn
+    "sss", // q_lindex
+    "sss", // q_rrindex
+    "sss", // q_irindex
+    "s-s", // q_rfetch
+    "s-s", // q_ifetch
+    "s-s", // q_itor
+    "i--", // q_jmp
+    "is-", // q_jmpf
+    "is-", // q_jmpt
+    "s--", // q_param
+    "i--", // q_labl
+    "---", // q_nop
+};
+static_assert(sizeof(QUAD_ARGUMENTS) / sizeof(QUAD_ARGUMENTS[0]) == q_nop + 1,
+              "QUAD_ARGUMENTS must have an entry for every op code");
+
+/* Two 64-bit hashes of the same data, FNV-1a over the bytes and a
+   multiply-xorshift over the words, which together make collisions between
+   different blocks as good as impossible. */
+class block_hash {
+private:
+    unsigned long fnv;
+    unsigned long mix;
+
+public:
+    block_hash()
+        : fnv(14695981039346656037UL),
+          mix(0x9e3779b97f4a7c15UL) {
+    }
+
+    void add(unsigned long word) {
+        for (int i = 0; i < 8; i++) {
+            fnv = (fnv ^ ((word >> (8 * i)) & 0xff)) * 1099511628211UL;
+        }
+        mix = (mix ^ word) * 0xbf58476d1ce4e5b9UL;
+        mix ^= mix >> 31;
+    }
+
+    void add(const char *s) {
+        size_t length = strlen(s);
+        add(length);
+        for (size_t i = 0; i < length; i++) {
+            add((unsigned long)(unsigned char)s[i]);
+        }
+    }
+
+    string digits() {
+        ostringstream result;
+        result << hex << setfill('0') << setw(16) << fnv << setw(16) << mix;
+        return result.str();
+    }
+};
+
+/* The compiler that made the code: the executable's size and modification
+   time. Rebuilding the compiler thus starts a new cache, so changes to the
+   code generator never meet code made by an older one. */
+static unsigned long compiler_identity() {
+    static const unsigned long identity = []() {
+        struct stat info;
+        if (stat("/proc/self/exe", &info) != 0) {
+            return 0UL;
+        }
+        return (unsigned long)info.st_size * 1000003UL
+               ^ (unsigned long)info.st_mtime;
+    }();
+    return identity;
+}
+
+/* The parameters of a procedure or function, which decide where its
+   parameters are found on the stack. */
+static void add_parameters(block_hash &h, parameter_symbol *last_param) {
+    for (; last_param != NULL; last_param = last_param->preceding) {
+        h.add(sym_tab->pool_lookup(last_param->id));
+        h.add(last_param->size);
+    }
+    h.add(0UL);
+}
+
+/* The parameter list a parameter belongs to. Like find_param() in
+   codegen.cc, this relies on the parameters being entered right after their
+   procedure. */
+static parameter_symbol *parameters_of(sym_index sym_p) {
+    sym_index owner = sym_p;
+    while (sym_tab->get_symbol_tag(owner) == SYM_PARAM) {
+        owner--;
+    }
+    symbol *env = sym_tab->get_symbol(owner);
+    if (env->tag == SYM_PROC) {
+        return env->get_procedure_symbol()->last_parameter;
+    }
+    return env->get_function_symbol()->last_parameter;
+}
+
+/* Describes a symbol used by a quad by what the code generator reads from
+   it. */
+static void add_symbol(block_hash &h, sym_index sym_p) {
+    if (sym_p == NULL_SYM) {
+        h.add(~0UL);
+        return;
+    }
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    // Not the name: temporaries are numbered through the whole program, and
+    // the code doesn't depend on what they are called.
+    h.add(sym->tag);
+    h.add(sym->type);
+    h.add(sym->level);
+    switch (sym->tag) {
+    case SYM_CONST:
+        if (sym->type == real_type) {
+            h.add(sym_tab->ieee(sym->get_constant_symbol()->const_value.rval));
+        } else {
+            h.add(sym->get_constant_symbol()->const_value.ival);
+        }
+        break;
+    case SYM_VAR:
+    case SYM_ARRAY:
+        h.add(sym->offset);
+        break;
+    case SYM_PARAM:
+        // Which of the parameters it is. find_param() in codegen.cc looks
+        // it up by name in the list.
+        h.add(sym_tab->pool_lookup(sym->id));
+        h.add(sym->offset);
+        add_parameters(h, parameters_of(sym_p));
+        break;
+    case SYM_PROC:
+        h.add(sym->get_procedure_symbol()->label_nr);
+        break;
+    case SYM_FUNC:
+        h.add(sym->get_function_symbol()->label_nr);
+        break;
+    default:
+        break;
+    }
+}
+
+/* The block itself, see prologue(). */
+static void add_block(block_hash &h, symbol *env) {
+    h.add(sym_tab->pool_lookup(env->id));
+    h.add(env->tag);
+    h.add(env->type);
+    h.add(env->level);
+    if (env->tag == SYM_PROC) {
+        procedure_symbol *proc = env->get_procedure_symbol();
+        h.add(proc->ar_size);
+        h.add(proc->label_nr);
+        add_parameters(h, proc->last_parameter);
+    } else {
+        function_symbol *func = env->get_function_symbol();
+        h.add(func->ar_size);
+        h.add(func->label_nr);
+        add_parameters(h, func->last_parameter);
+    }
+}
+
+vector<sym_index> quad_symbols(quad_list *q_list) {
+    vector<sym_index> symbols;
+    set<sym_index> seen;
+    quad_list_iterator it(q_list);
+    for (quadruple *q = it.get_current(); q != NULL; q = it.get_next()) {
+        const char *arguments = QUAD_ARGUMENTS[q->op_code];
+        sym_index syms[3] = { q->sym1, q->sym2, q->sym3 };
+        for (int i = 0; i < 3; i++) {
+            if (arguments[i] == 's' && syms[i] != NULL_SYM && seen.insert(syms[i]).second) {
+                symbols.push_back(syms[i]);
+            }
+        }
+    }
+    return symbols;
+}
+
+/* Besides what the code generator reads, the optimizer tells the symbols
+   apart, and the labels and temporaries it makes are numbered after those
+   made before it. */
+string optimizer_key(quad_list *q_list, symbol *env, const vector<sym_index> &symbols,
+                     const map<symbol *, string> &optimized) {
+    block_hash h;
+    h.add(compiler_identity());
+    add_block(h, env);
+    h.add(sym_tab->get_label_count());
+
+    map<sym_index, size_t> numbers;
+    for (size_t k = 0; k < symbols.size(); k++) {
+        numbers[symbols[k]] = k;
+    }
+    quad_list_iterator it(q_list);
+    for (quadruple *q = it.get_current(); q != NULL; q = it.get_next()) {
+        h.add(q->op_code);
+        const char *arguments = QUAD_ARGUMENTS[q->op_code];
+        long ints[3] = { q->int1, q->int2, q->int3 };
+        sym_index syms[3] = { q->sym1, q->sym2, q->sym3 };
+        for (int i = 0; i < 3; i++) {
+            if (arguments[i] == 'i') {
+                h.add(ints[i]);
+            } else if (arguments[i] == 's') {
+                add_symbol(h, syms[i]);
+                if (syms[i] == NULL_SYM) {
+                    continue;
+                }
+                h.add(numbers[syms[i]]);
+                // A callee optimized before is summarized, and maybe
+                // inlined, by what its own key covers.
+                sym_type tag = sym_tab->get_symbol_tag(syms[i]);
+                if (tag == SYM_PROC || tag == SYM_FUNC) {
+                    map<symbol *, string>::const_iterator callee =
+                        optimized.find(sym_tab->get_symbol(syms[i]));
+                    h.add(callee == optimized.end() ? "" : callee->second.c_str());
+                }
+            }
+        }
+    }
+    return h.digits();
+}
+
+/* The symbol of a name declared at a level, if its scope is still open.
+   The name is installed in the string pool only for the lookup. */
+static sym_index find_symbol(const string &name, block_level level) {
+    pool_index id = sym_tab->pool_install(const_cast<char *>(name.c_str()));
+    sym_index sym_p = sym_tab->lookup_symbol(id);
+    while (sym_p != NULL_SYM) {
+        symbol *sym = sym_tab->get_symbol(sym_p);
+        if (sym->level == level && sym_tab->pool_compare(sym->id, id)) {
+            break;
+        }
+        sym_p = sym->hash_link;
+    }
+    sym_tab->pool_forget(id);
+    return sym_p;
+}
+
+/* An entry starts with the number of labels, the inliner's room and the
+   types of the temporaries the optimizer made, followed by a line per quad:
+   the op code and the three arguments. A symbol argument is '-' for none,
+   r<k> for the k:th symbol of the block before optimization, t<k> for the
+   k:th temporary made, and otherwise n<level>:<tag>:<type>:<name> for a
+   symbol declared in a scope that is open when the block is compiled. */
+bool write_optimized(quad_list *q_list, const vector<sym_index> &symbols,
+                     sym_index first_symbol, long first_label, int room, string &entry) {
+    ostringstream out;
+    sym_index count = sym_tab->get_symbol_count();
+    out << sym_tab->get_label_count() - first_label << " " << room << " "
+        << count - first_symbol << "\n";
+    for (sym_index i = first_symbol; i < count; i++) {
+        if (!sym_tab->is_temp_var(i)) {
+            return false;
+        }
+        out << sym_tab->get_symbol_type(i) << "\n";
+    }
+
+    map<sym_index, size_t> numbers;
+    for (size_t k = 0; k < symbols.size(); k++) {
+        numbers[symbols[k]] = k;
+    }
+    quad_list_iterator it(q_list);
+    for (quadruple *q = it.get_current(); q != NULL; q = it.get_next()) {
+        out << q->op_code;
+        const char *arguments = QUAD_ARGUMENTS[q->op_code];
+        long ints[3] = { q->int1, q->int2, q->int3 };
+        sym_index syms[3] = { q->sym1, q->sym2, q->sym3 };
+        for (int i = 0; i < 3; i++) {
+            if (syms[i] != ints[i]) {
+                return false;
+            }
+            out << " ";
+            if (arguments[i] != 's') {
+                out << ints[i];
+            } else if (syms[i] == NULL_SYM) {
+                out << "-";
+            } else if (numbers.count(syms[i])) {
+                out << "r" << numbers[syms[i]];
+            } else if (syms[i] >= first_symbol) {
+                out << "t" << syms[i] - first_symbol;
+            } else {
+                symbol *sym = sym_tab->get_symbol(syms[i]);
+                string name = sym_tab->pool_lookup(sym->id);
+                if (find_symbol(name, sym->level) != syms[i]) {
+                    return false;
+                }
+                out << "n" << sym->level << ":" << sym->tag << ":" << sym->type << ":" << name;
+            }
+        }
+        out << "\n";
+    }
+    entry = out.str();
+    return true;
+}
+
+/* Reads a symbol argument of an entry, see above. */
+static bool read_symbol(const string &token, const vector<sym_index> &symbols,
+                        sym_index first_symbol, long temporaries, sym_index &sym_p) {
+    if (token == "-") {
+        sym_p = NULL_SYM;
+        return true;
+    }
+    istringstream in(token.substr(1));
+    long k;
+    char separator;
+    if (token[0] == 'r') {
+        if (!(in >> k) || k < 0 || k >= (long)symbols.size()) {
+            return false;
+        }
+        sym_p = symbols[k];
+        return true;
+    }
+    if (token[0] == 't') {
+        if (!(in >> k) || k < 0 || k >= temporaries) {
+            return false;
+        }
+        sym_p = first_symbol + k;
+        return true;
+    }
+    long level, tag, type;
+    string name;
+    if (token[0] != 'n' || !(in >> level >> separator >> tag >> separator >> type >> separator) ||
+        !getline(in, name) || name.empty()) {
+        return false;
+    }
+    sym_p = find_symbol(name, level);
+    return sym_p != NULL_SYM && sym_tab->get_symbol_tag(sym_p) == tag &&
+           sym_tab->get_symbol_type(sym_p) == type;
+}
+
+quad_list *read_optimized(const string &entry, const vector<sym_index> &symbols,
+                          int symbol_limit, int last_label) {
+    istringstream in(entry);
+    long labels, temporaries;
+    int room;
+    sym_index first_symbol = sym_tab->get_symbol_count();
+    if (!(in >> labels >> room >> temporaries) || first_symbol + room > symbol_limit) {
+        return NULL;
+    }
+    vector<sym_index> types(temporaries);
+    for (long i = 0; i < temporaries; i++) {
+        if (!(in >> types[i])) {
+            return NULL;
+        }
+    }
+
+    // All of it is read before anything is made, so an entry that can't be
+    // used leaves the symbol table as it was.
+    vector<long> arguments;
+    int op_code;
+    while (in >> op_code) {
+        if (op_code < 0 || op_code > q_nop) {
+            return NULL;
+        }
+        arguments.push_back(op_code);
+        for (int i = 0; i < 3; i++) {
+            string token;
+            if (!(in >> token)) {
+                return NULL;
+            }
+            if (QUAD_ARGUMENTS[op_code][i] == 's') {
+                sym_index sym_p;
+                if (!read_symbol(token, symbols, first_symbol, temporaries, sym_p)) {
+                    return NULL;
+                }
+                arguments.push_back(sym_p);
+            } else {
+                char *end;
+                arguments.push_back(strtol(token.c_str(), &end, 10));
+                if (*end != '\0') {
+                    return NULL;
+                }
+            }
+        }
+    }
+    if (!in.eof()) {
+        return NULL;
+    }
+
+    for (long i = 0; i < temporaries; i++) {
+        sym_tab->gen_temp_var(types[i]);
+    }
+    for (long i = 0; i < labels; i++) {
+        sym_tab->get_next_label();
+    }
+    quad_list *q_list = new quad_list(last_label);
+    for (size_t i = 0; i < arguments.size(); i += 4) {
+        *q_list += new quadruple((quad_op_type)arguments[i], arguments[i + 1],
+                                 arguments[i + 2], arguments[i + 3]);
+    }
+    return q_list;
+}
+
+string block_key(quad_list *q_list, symbol *env) {
+    block_hash h;
+    h.add(compiler_identity());
+    add_block(h, env);
+
+    quad_list_iterator it(q_list);
+    for (quadruple *q = it.get_current(); q != NULL; q = it.get_next()) {
+        h.add(q->op_code);
+        const char *arguments = QUAD_ARGUMENTS[q->op_code];
+        long ints[3] = { q->int1, q->int2, q->int3 };
+        sym_index syms[3] = { q->sym1, q->sym2, q->sym3 };
+        for (int i = 0; i < 3; i++) {
+            if (arguments[i] == 'i') {
+                h.add(ints[i]);
+            } else if (arguments[i] == 's') {
+                add_symbol(h, syms[i]);
+            }
+        }
+    }
+    return h.digits();
+}
+
+static string entry_path(const string &directory, const string &name) {
+    return directory + "/" + name;
+}
+
+bool cache_lookup(const string &directory, const string &name, string &entry) {
+    ifstream file(entry_path(directory, name).c_str());
+    if (!file) {
+        return false;
+    }
+    ostringstream contents;
+    contents << file.rdbuf();
+    entry = contents.str();
+    return true;
+}
+
+void cache_store(const string &directory, const string &name, const string &entry) {
+    // The directory is made the first time; if that fails, so does mkstemp().
+    mkdir(directory.c_str(), 0777);
+
+    string temporary = directory + "/." + name + "XXXXXX";
+    int fd = mkstemp(&temporary[0]);
+    if (fd < 0) {
+        return;
+    }
+    bool written = write(fd, entry.data(), entry.size()) == (ssize_t)entry.size();
+    close(fd);
+    if (!written || rename(temporary.c_str(), entry_path(directory, name).c_str()) != 0) {
+        unlink(temporary.c_str());
+    }
+}
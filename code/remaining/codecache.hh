@@ -0,0 +1,80 @@
+#ifndef __CODECACHE_HH__
+#define __CODECACHE_HH__
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "quads.hh"
+#include "symtab.hh"
+
+using namespace std;
+
+/* A cache of optimized quads and generated assembler code, one file of each
+   per block, in a directory given with the -C flag.
+
+   The optimizer looks a block up by a hash of its quads as generated from
+   the AST, before any pass has run, together with the keys of the blocks it
+   calls that were optimized before it, since their summaries and bodies
+   take part in its optimization. An entry holds the optimized quads, and
+   how many temporaries and labels the optimizer made for them, so a block
+   that comes up again gets exactly the quads, symbols and labels it got the
+   first time, without running the passes.
+
+   The code generator then looks the block up by a hash of everything it
+   reads when translating it: its final quad list, where the symbols the
+   quads use live (level, offset, which parameter of which parameter list,
+   the values of constants, the labels of called procedures), the
+   activation record and label of the block itself. The final offsets
+   depend on the procedures nested in the block, which the first key
+   doesn't cover, so the code has a key of its own.
+
+   Both keys include which compiler made the entry. The quads already
+   depend on the AST of the block and the flags, so an edit to one
+   procedure only makes the blocks that really changed, and those calling
+   them, miss the cache. The symbols are described by what they are rather
+   than by their index in the symbol table, so adding a declaration
+   elsewhere doesn't change the keys. Several compilations, in threads or
+   processes, may use the same directory at once: entries are written to a
+   temporary file and renamed into place. */
+
+//! The symbols the quads of a block use, in the order they first appear.
+//! The optimizer's entries refer to them by their place in this list.
+vector<sym_index> quad_symbols(quad_list *);
+
+//! The optimizer's key of a block. Arg 1 = the quads before optimization,
+//! arg 2 = the block's procedure or function (or main program), arg 3 = the
+//! symbols of arg 1 as listed by quad_symbols(), arg 4 = the keys of the
+//! blocks optimized before it in this compilation.
+string optimizer_key(quad_list *, symbol *, const vector<sym_index> &,
+                     const map<symbol *, string> &);
+
+//! Makes the optimizer's entry for a block in arg 6. Arg 1 = the optimized
+//! quads, arg 2 = the symbols of the block before optimization, arg 3 and
+//! arg 4 = the symbol count and label count before optimization, arg 5 =
+//! how many symbols past arg 3 the inliner needed room for. Returns false
+//! if the quads use a symbol that another compilation can't find again.
+bool write_optimized(quad_list *, const vector<sym_index> &, sym_index, long,
+                     int, string &);
+
+//! Reads an entry made by write_optimized() for a block whose symbols are
+//! arg 2, makes the temporaries and labels it needs, and returns the
+//! optimized quads, ending with the label arg 4. Returns NULL, changing
+//! nothing, if the entry can't be used: if the inliner's room would reach
+//! past the symbol count arg 3, or a symbol isn't found.
+quad_list *read_optimized(const string &, const vector<sym_index> &, int, int);
+
+//! The code generator's key of a block, as a string of hex digits. Arg 1 =
+//! the final quads, arg 2 = the procedure or function (or main program)
+//! they belong to.
+string block_key(quad_list *, symbol *);
+
+//! Looks up an entry named arg 2 in the cache directory given as arg 1.
+//! Returns true and stores the entry in arg 3 if it was found.
+bool cache_lookup(const string &, const string &, string &);
+
+//! Stores an entry in the cache directory. Failing to do so isn't an error;
+//! the block is just optimized or generated again next time.
+void cache_store(const string &, const string &, const string &);
+
+#endif
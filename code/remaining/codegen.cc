@@ -7,20 +7,30 @@
 #include "symtab.hh"
 #include "quads.hh"
 #include "codegen.hh"
+#include "codecache.hh"
+#include "profile.hh"
+#include "counters.hh"
+#include "context.hh"
 
 using namespace std;
 
-// Defined in main.cc.
-extern bool assembler_trace;
-
-// Used in parser.y. Ideally the filename should be parametrized, but it's not
-// _that_ important...
-code_generator *code_gen = new code_generator("d.out");
+// Used in parser.y. Set by compilation_context::activate(), which also owns
+// the file the code is written to.
+thread_local code_generator *code_gen = NULL;
 
 // Constructor.
-code_generator::code_generator(const string object_file_name) {
-    out.open(object_file_name);
+code_generator::code_generator(const string object_file_name)
+    : out(file) {
+    file.open(object_file_name);
+
+    reg[RAX] = "rax";
+    reg[RCX] = "rcx";
+    reg[RDX] = "rdx";
+}
 
+/* Used by the compile server, which sends the code back to its client. */
+code_generator::code_generator(ostream &stream)
+    : out(stream) {
     reg[RAX] = "rax";
     reg[RCX] = "rcx";
     reg[RDX] = "rdx";
@@ -30,24 +40,94 @@ code_generator::code_generator(const string object_file_name) {
 code_generator::~code_generator() {
     // Make sure we close the outfile before exiting the compiler.
     out << flush;
-    out.close();
+    if (file.is_open()) {
+        file.close();
+    }
 }
 
 /* This method is called from parser.y when code generation is to start.
    The argument is a quad_list representing the body of the procedure, and
-   the symbol for the environment for which code is being generated. */
+   the symbol for the environment for which code is being generated. With a
+   cache directory (the -C flag), a block whose code has been generated
+   before is copied from the cache instead, see codecache.hh. The trace
+   printouts of -t show symbol table contents that the key doesn't cover, so
+   the cache isn't used then. */
 void code_generator::generate_assembler(quad_list *q, symbol *env) {
+    phase_timer timer(PHASE_ASSEMBLER, env);
+    if (cache_directory.empty() || assembler_trace) {
+        generate_block(q, env);
+        return;
+    }
+
+    string key = block_key(q, env);
+    string code;
+    if (!cache_lookup(cache_directory, key + ".s", code)) {
+        ostringstream buffer;
+        code_generator generator(buffer);
+        generator.generate_block(q, env);
+        code = buffer.str();
+        cache_store(cache_directory, key + ".s", code);
+    }
+    out << code << flush;
+}
+
+/* Translates a block, see above. */
+void code_generator::generate_block(quad_list *q, symbol *env) {
+    block_label = env->tag == SYM_FUNC ? env->get_function_symbol()->label_nr
+                                       : env->get_procedure_symbol()->label_nr;
+    local_label_nr = 0;
+
     prologue(env);
     expand(q);
     epilogue(env);
 }
 
+/* The assembler treats a symbol set to an undefined one as another name for
+   it, which the linker then resolves. */
+void code_generator::import_label(long label, const string &name) {
+    out << "\t.set\tL" << label << ", " << name << endl;
+}
+
+void code_generator::export_label(long label, const string &name) {
+    out << "\t.globl\t" << name << endl;
+    out << "\t.set\t" << name << ", L" << label << endl;
+}
+
+/* Labels needed by the code of a single quad are numbered within the block,
+   after the label of the block itself, so that the code of a block doesn't
+   depend on the blocks generated before it. They are printed after an "L"
+   like the other labels. */
+string code_generator::local_label() {
+    return to_string(block_label) + "_" + to_string(local_label_nr++);
+}
+
 /* This method aligns a frame size on an 8-byte boundary. Used by prologue().
  */
 int code_generator::align(int frame_size) {
     return ((frame_size + 7) / 8) * 8;
 }
 
+// The labels of the predefined write and trunc in diesel_glue.s.
+const int WRITE_LABEL = 1;
+const int TRUNC_LABEL = 2;
+
+/* Whether q calls the predefined write or trunc, which expand() generates in
+   place. The q_param of such a call pushes nothing when it comes right
+   before it, so the call is only inlined then, and otherwise made as
+   usual. */
+static bool is_inline_call(quadruple *q) {
+    if (q == NULL || q->op_code != q_call || q->int2 != 1) {
+        return false;
+    }
+    symbol *f_sym = sym_tab->get_symbol(q->sym1);
+    if (f_sym->level != 0) {
+        return false;
+    }
+    int label = f_sym->tag == SYM_PROC ? f_sym->get_procedure_symbol()->label_nr
+                                       : f_sym->get_function_symbol()->label_nr;
+    return label == WRITE_LABEL || label == TRUNC_LABEL;
+}
+
 const char *get_symbol_name(sym_index sym_p) {
     auto *sym = sym_tab->get_symbol(sym_p);
     return sym_tab->pool_lookup(sym->id);
@@ -80,6 +160,7 @@ void code_generator::prologue(symbol *new_env) {
         fatal("code_generator::prologue() called for non-proc/func");
         return;
     }
+    frame_level = new_env->level + 1;
 
     /* Print out the label number (a SYM_PROC/ SYM_FUNC attribute) */
     out << "L" << label_nr << ":"
@@ -156,7 +237,14 @@ void code_generator::find_param(sym_index sym_p, int *level, int *offset) {
     auto *symbol = sym_tab->get_symbol(sym_p);
     *level = symbol->level;
     // +2 because of [Previous RBP] and [Main RBP] which always are precent.
-    auto *env = sym_tab->get_context(*level);
+    // The parameters of a procedure are entered right after it. Look for
+    // it that way rather than among the open scopes, since in whole-program
+    // mode its scope has been closed when code is generated.
+    sym_index owner = sym_p;
+    while (sym_tab->get_symbol_tag(owner) == SYM_PARAM) {
+        owner--;
+    }
+    auto *env = sym_tab->get_symbol(owner);
     parameter_symbol *last_param;
     if (env->tag == SYM_PROC) {
         last_param = env->get_procedure_symbol()->last_parameter;
@@ -189,6 +277,17 @@ void code_generator::frame_address(int level, const register_type dest) {
         << endl;
 }
 
+/* Returns the register to address a frame with when accessing a variable
+   or parameter. The frame of the block being generated is already in rbp,
+   so only other frames are loaded from the display (into rcx). */
+string code_generator::frame_register(int level) {
+    if (level == frame_level) {
+        return "rbp";
+    }
+    frame_address(level, RCX);
+    return reg[RCX];
+}
+
 /* This function fetches the value of a variable or a constant into a
    register. */
 void code_generator::fetch(sym_index sym_p, register_type dest) {
@@ -205,21 +304,21 @@ void code_generator::fetch(sym_index sym_p, register_type dest) {
     } else if (f_sym->tag == SYM_VAR) {
         int level, offset;
         find(sym_p, &level, &offset);
-        frame_address(level, RCX);
+        string base = frame_register(level);
         out << "\t\t"
             << "mov\t"
             << reg[dest]
-            << ", [rcx-" << offset << "]"
+            << ", [" << base << "-" << offset << "]"
             << endl;
 
     } else if (f_sym->tag == SYM_PARAM) {
         int level, offset;
         find_param(sym_p, &level, &offset);
-        frame_address(level, RCX);
+        string base = frame_register(level);
         out << "\t\t"
             << "mov\t"
             << reg[dest] << ", "
-            << "[rcx+" << offset << "]"
+            << "[" << base << "+" << offset << "]"
             << endl;
 
     } else {
@@ -244,23 +343,23 @@ void code_generator::fetch_float(sym_index sym_p) {
     } else if (f_sym->tag == SYM_VAR) {
         int level, offset;
         find(sym_p, &level, &offset);
-        frame_address(level, RCX);
+        string base = frame_register(level);
         out << "\t\t"
             << "fld"
             << "\t"
             << "qword ptr "
-            << "[rcx-" << offset << "]"
+            << "[" << base << "-" << offset << "]"
             << endl;
 
     } else if (f_sym->tag == SYM_PARAM) {
         int level, offset;
         find_param(sym_p, &level, &offset);
-        frame_address(level, RCX);
+        string base = frame_register(level);
         out << "\t\t"
             << "fld"
             << "\t"
             << "qword ptr "
-            << "[rcx+" << offset << "]"
+            << "[" << base << "+" << offset << "]"
             << endl;
 
     } else {
@@ -277,20 +376,20 @@ void code_generator::store(register_type src, sym_index sym_p) {
     if (f_sym->tag == SYM_VAR) {
         int level, offset;
         find(sym_p, &level, &offset);
-        frame_address(level, RCX);
+        string base = frame_register(level);
         out << "\t\t"
             << "mov\t"
-            << "[rcx-" << offset << "], "
+            << "[" << base << "-" << offset << "], "
             << reg[src]
             << endl;
 
     } else if (f_sym->tag == SYM_PARAM) {
         int level, offset;
         find_param(sym_p, &level, &offset);
-        frame_address(level, RCX);
+        string base = frame_register(level);
         out << "\t\t"
             << "mov\t"
-            << "[rcx+" << offset << "]"
+            << "[" << base << "+" << offset << "]"
             << ", " << reg[src]
             << endl;
     } else {
@@ -305,11 +404,11 @@ void code_generator::store_float(sym_index sym_p) {
     if (f_sym->tag == SYM_VAR) {
         int level, offset;
         find(sym_p, &level, &offset);
-        frame_address(level, RCX);
+        string base = frame_register(level);
         out << "\t\t"
             << "fstp"
             << "\t"
-            << "qword ptr [rcx-" << offset << "]"
+            << "qword ptr [" << base << "-" << offset << "]"
             << endl;
     } else {
         fatal("Can only store in SYM_VAR");
@@ -327,6 +426,14 @@ void code_generator::array_address(sym_index sym_p, register_type dest) {
 
     int level = f_sym->level;
     int offset = f_sym->offset + 8 * (1 + f_sym->level);
+    if (level == frame_level) {
+        out << "\t\t"
+            << "lea\t"
+            << reg[dest]
+            << ", [rbp-" << offset << "]"
+            << endl;
+        return;
+    }
     frame_address(level, dest);
 
     out << "\t\t"
@@ -337,6 +444,38 @@ void code_generator::array_address(sym_index sym_p, register_type dest) {
         << endl;
 }
 
+/* trunc converts with cvttsd2si, which truncates like the x87 code of L2 in
+   diesel_glue.s. write puts the character straight into the output buffer
+   of diesel_rts.c while diesel_output_limit says there's room and nothing
+   else to do, and otherwise calls myputchar, which also flushes the buffer
+   and sets the limit. myputchar is called with the stack aligned as it was
+   from L1, since the argument isn't pushed. */
+void code_generator::inline_call(quadruple *q, sym_index argument) {
+    fetch(argument, RAX);
+    symbol *f_sym = sym_tab->get_symbol(q->sym1);
+    if (f_sym->tag == SYM_FUNC) {
+        out << "\t\t" << "movq" << "\t" << "xmm0, rax" << endl;
+        out << "\t\t" << "cvttsd2si" << "\t" << "rax, xmm0" << endl;
+        store(RAX, q->sym3);
+        return;
+    }
+
+    string slow = local_label();
+    string done = local_label();
+    out << "\t\t" << "mov" << "\t" << "rcx, qword ptr [rip+diesel_output_length]" << endl;
+    out << "\t\t" << "cmp" << "\t" << "rcx, qword ptr [rip+diesel_output_limit]" << endl;
+    out << "\t\t" << "jge" << "\t" << "L" << slow << endl;
+    out << "\t\t" << "lea" << "\t" << "rdx, [rip+diesel_output]" << endl;
+    out << "\t\t" << "mov" << "\t" << "byte ptr [rdx+rcx], al" << endl;
+    out << "\t\t" << "inc" << "\t" << "rcx" << endl;
+    out << "\t\t" << "mov" << "\t" << "qword ptr [rip+diesel_output_length], rcx" << endl;
+    out << "\t\t" << "jmp" << "\t" << "L" << done << endl;
+    out << "L" << slow << ":" << endl;
+    out << "\t\t" << "mov" << "\t" << "rdi, rax" << endl;
+    out << "\t\t" << "call" << "\t" << "myputchar" << endl;
+    out << "L" << done << ":" << endl;
+}
+
 /* This method expands a quad_list into assembler code, quad for quad. */
 void code_generator::expand(quad_list *q_list) {
     long quad_nr = 0; // Just to make debug output easier to read.
@@ -346,8 +485,17 @@ void code_generator::expand(quad_list *q_list) {
 
     quadruple *q = ql_iterator->get_current(); // This is the head of the list.
 
+    // Only counts anything when the compiler is built with the counters,
+    // see counters.hh.
+    line_counter lines(out);
+
+    // The argument of a call of write or trunc that is generated in place,
+    // from the q_param before it.
+    sym_index inline_argument = NULL_SYM;
+
     while (q != NULL) {
         quad_nr++;
+        long lines_before = lines.lines();
 
         // We always do labels here so that a branch doesn't miss the
         // trace code.
@@ -375,8 +523,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
 
         case q_inot: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch(q->sym1, RAX);
             out << "\t\t"
@@ -462,8 +610,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
 
         case q_ior: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch(q->sym1, RAX);
             out << "\t\t"
@@ -506,8 +654,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
         }
         case q_iand: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch(q->sym1, RAX);
             out << "\t\t"
@@ -600,8 +748,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
 
         case q_req: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch_float(q->sym1);
             fetch_float(q->sym2);
@@ -641,8 +789,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
         }
         case q_ieq: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
@@ -677,8 +825,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
         }
         case q_rne: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch_float(q->sym1);
             fetch_float(q->sym2);
@@ -718,8 +866,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
         }
         case q_ine: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
@@ -754,8 +902,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
         }
         case q_rlt: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             // We need to push in reverse order for this to work
             fetch_float(q->sym2);
@@ -796,8 +944,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
         }
         case q_ilt: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
@@ -832,8 +980,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
         }
         case q_rgt: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             // We need to push in reverse order for this to work
             fetch_float(q->sym2);
@@ -874,8 +1022,8 @@ void code_generator::expand(quad_list *q_list) {
             break;
         }
         case q_igt: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
+            string label = local_label();
+            string label2 = local_label();
 
             fetch(q->sym1, RAX);
             fetch(q->sym2, RCX);
@@ -925,12 +1073,23 @@ void code_generator::expand(quad_list *q_list) {
             store(RAX, q->sym3);
             break;
 
-        case q_param:
+        case q_param: {
+            // Left for the call if it's generated in place.
+            quad_list_iterator next_quad = *ql_iterator;
+            if (is_inline_call(next_quad.get_next())) {
+                inline_argument = q->sym1;
+                break;
+            }
             fetch(q->sym1, RAX);
             out << "\t\tpush\trax" << endl;
             break;
-
+        }
         case q_call: {
+            if (inline_argument != NULL_SYM) {
+                inline_call(q, inline_argument);
+                inline_argument = NULL_SYM;
+                break;
+            }
             // Call
             auto *f_sym = sym_tab->get_symbol(q->sym1);
             auto label = 0;
@@ -948,6 +1107,30 @@ void code_generator::expand(quad_list *q_list) {
             out << "\t\tadd\trsp, " << q->int2 * 8 << endl;
             break;
         }
+        case q_tcall: {
+            // Tail call. The pushed arguments are moved over our own
+            // parameters, the last one closest to the return address, and
+            // our frame is dropped. The callee then returns straight to our
+            // caller, who pops the parameters it pushed.
+            auto *f_sym = sym_tab->get_symbol(q->sym1);
+            auto label = 0;
+            if (f_sym->tag == SYM_PROC) {
+                label = f_sym->get_procedure_symbol()->label_nr;
+            } else {
+                label = f_sym->get_function_symbol()->label_nr;
+            }
+            for (int i = 0; i < q->int2; i++) {
+                out << "\t\t"
+                    << "mov\t"
+                    << "rax, [rsp+" << i * STACK_WIDTH << "]" << endl;
+                out << "\t\t"
+                    << "mov\t"
+                    << "[rbp+" << 2 * STACK_WIDTH + i * STACK_WIDTH << "], rax" << endl;
+            }
+            out << "\t\tleave" << endl;
+            out << "\t\tjmp\tL" << label << endl;
+            break;
+        }
         case q_rreturn:
         case q_ireturn:
             fetch(q->sym2, RAX);
@@ -990,24 +1173,27 @@ void code_generator::expand(quad_list *q_list) {
             store(RAX, q->sym3);
             break;
 
-        case q_itor: {
-            block_level level; // Current scope level.
-            int offset;        // Offset within current activation record.
-
-            find(q->sym1, &level, &offset);
-            frame_address(level, RCX);
+        case q_rfetch:
+        case q_ifetch:
+            // The address was computed earlier by a q_lindex.
+            fetch(q->sym1, RAX);
             out << "\t\t"
-                << "fild"
+                << "mov"
                 << "\t"
-                << "qword ptr [rcx";
-            if (offset >= 0) {
-                out << "+" << offset;
-            } else {
-                out << offset; // Implicit "-"
-            }
-            out << "]" << endl;
+                << "rax, [rax]" << endl;
+            store(RAX, q->sym3);
+            break;
+
+        case q_itor:
+            // Go through the stack, since the operand may be a constant or
+            // a parameter as well as a variable.
+            fetch(q->sym1, RAX);
+            out << "\t\t" << "sub" << "\t" << "rsp, 8" << endl;
+            out << "\t\t" << "mov" << "\t" << "[rsp], rax" << endl;
+            out << "\t\t" << "fild" << "\t" << "qword ptr [rsp]" << endl;
+            out << "\t\t" << "add" << "\t" << "rsp, 8" << endl;
             store_float(q->sym3);
-        } break;
+            break;
 
         case q_jmp:
             out << "\t\t"
@@ -1028,6 +1214,18 @@ void code_generator::expand(quad_list *q_list) {
                 << "L" << q->int1 << endl;
             break;
 
+        case q_jmpt:
+            fetch(q->sym2, RAX);
+            out << "\t\t"
+                << "cmp"
+                << "\t"
+                << "rax, 0" << endl;
+            out << "\t\t"
+                << "jne"
+                << "\t"
+                << "L" << q->int1 << endl;
+            break;
+
         case q_labl:
             // We handled this one above already.
             break;
@@ -1037,6 +1235,7 @@ void code_generator::expand(quad_list *q_list) {
             fatal("code_generator::expand(): q_nop quadruple produced.");
             return;
         }
+        COUNT_ADD(assembler_lines[q->op_code], lines.lines() - lines_before);
 
         // Get the next quad from the list.
         q = ql_iterator->get_next();
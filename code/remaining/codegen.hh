@@ -25,8 +25,20 @@ private:
     // Register array.
     string reg[3];
 
-    // Output file stream.
-    ofstream out;
+    // Output file stream, if the generator writes to a file.
+    ofstream file;
+
+    // Where the code goes: the file, or a stream given by the caller.
+    ostream &out;
+
+    // Label of the block being generated, and the number of labels made
+    // for it so far by local_label().
+    int block_label;
+    int local_label_nr;
+
+    // Lexical level of the variables of the block being generated, whose
+    // frame is addressed by rbp.
+    int frame_level;
 
     //! Aligns a stack frame on an 8-byte boundary.
     int align(int);
@@ -89,10 +101,29 @@ private:
      */
     void frame_address(int level, const register_type);
 
+    //! Returns the register holding the frame of a level, loading it if needed.
+    string frame_register(int level);
+
+    //! Returns a new label, unique within the program, for the current block.
+    string local_label();
+
+    /*!
+      Generates a call of the predefined write or trunc in place, without
+      calling diesel_glue.s, given the symbol its single argument is in.
+      Only for calls that is_inline_call() accepts.
+     */
+    void inline_call(quadruple *, sym_index);
+
+    //! Translates a block, without looking in the cache.
+    void generate_block(quad_list *, symbol *);
+
 public:
     // Constructor. Arg = filename of assembler outfile.
     code_generator(const string);
 
+    // Constructor. Arg = stream to write the assembler code to.
+    code_generator(ostream &);
+
     // Destructor.
     ~code_generator();
 
@@ -101,6 +132,16 @@ public:
       expansion of a code block represented as a quad list.
      */
     void generate_assembler(quad_list *, symbol *env);
+
+    //! Makes a label stand for a name defined in another object file, so a
+    //! call to the label reaches it. Used for imported procedures, see
+    //! unit.hh.
+    void import_label(long, const string &);
+
+    //! Makes a label visible to the linker under the given name.
+    void export_label(long, const string &);
 };
 
+extern thread_local code_generator *code_gen;
+
 #endif
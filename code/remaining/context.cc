@@ -0,0 +1,205 @@
+#include <iostream>
+
+#include "symtab.hh"
+#include "semantic.hh"
+#include "optimize.hh"
+#include "cfg.hh"
+#include "quadopt.hh"
+#include "callgraph.hh"
+#include "codegen.hh"
+#include "unit.hh"
+#include "profile.hh"
+#include "context.hh"
+#include "parser.hh"
+
+using namespace std;
+
+/* Defined in scanner.cc (the generated file). The handle is a yyscan_t,
+   which is a void pointer. */
+extern int yylex_init(void **);
+extern int yylex_destroy(void *);
+extern void yyset_in(FILE *, void *);
+
+/* The flags of the compilation running on this thread. Set by activate(). */
+thread_local bool assembler_trace = false;
+thread_local bool print_ast = false;
+thread_local bool print_quads = false;
+thread_local bool print_cfg = false;
+thread_local bool print_inlining = false;
+thread_local bool typecheck = true;
+thread_local bool optimize = true;
+thread_local bool quads = true;
+thread_local bool assembler = true;
+thread_local bool whole_program = false;
+thread_local string cache_directory;
+
+static thread_local compilation_context *current_context = NULL;
+
+/* The defaults, ie, what the compiler does without any flags. */
+compile_options::compile_options()
+    : assembler_trace(false),
+      print_ast(false),
+      print_quads(false),
+      print_cfg(false),
+      print_inlining(false),
+      typecheck(true),
+      optimize(true),
+      quads(true),
+      assembler(true),
+      whole_program(false),
+      cache_directory(""),
+      interface_file(""),
+      profile(false) {
+}
+
+/* Constructor. */
+compilation_context::compilation_context(const compile_options &o,
+                                         const string object_file_name)
+    : options(o),
+      messages(&cerr),
+      errors(0) {
+    create();
+    generator = new code_generator(object_file_name);
+}
+
+/* Constructor for compiling to a stream, as the compile server does. */
+compilation_context::compilation_context(const compile_options &o,
+                                         ostream &code,
+                                         ostream &errors_out)
+    : options(o),
+      messages(&errors_out),
+      errors(0) {
+    create();
+    generator = new code_generator(code);
+}
+
+/* The symbol table comes first, since the other parts may look things up in
+   it as they are built. */
+void compilation_context::create() {
+    symbols = new symbol_table();
+    checker = NULL;
+    ast_opt = NULL;
+    quad_optimization = NULL;
+    procedure_summaries = NULL;
+    graph = NULL;
+    generator = NULL;
+    units = NULL;
+    measurements = options.profile ? new compile_profile() : NULL;
+
+    compilation_context *previous = current_context;
+    activate();
+    checker = new semantic();
+    ast_opt = new ast_optimizer();
+    quad_optimization = new quad_optimizer();
+    procedure_summaries = new call_summaries();
+    graph = new call_graph();
+    units = new unit_linker();
+    if (previous != NULL) {
+        previous->activate();
+    }
+}
+
+/* Destructor. Only the code generator needs to be taken down properly, to
+   get the outfile closed. The symbol table and the quads and ASTs pointing
+   into it are left as they are, as in the rest of the compiler. */
+compilation_context::~compilation_context() {
+    delete generator;
+    delete units;
+    delete measurements;
+    delete graph;
+    delete procedure_summaries;
+    delete quad_optimization;
+    delete ast_opt;
+    delete checker;
+    if (current_context == this) {
+        current_context = NULL;
+    }
+}
+
+void compilation_context::activate() {
+    current_context = this;
+
+    sym_tab = symbols;
+    type_checker = checker;
+    optimizer = ast_opt;
+    quad_opt = quad_optimization;
+    summaries = procedure_summaries;
+    program_graph = graph;
+    code_gen = generator;
+    linker = units;
+    ::profile = measurements;
+    error_stream = messages;
+
+    ::assembler_trace = options.assembler_trace;
+    ::print_ast = options.print_ast;
+    ::print_quads = options.print_quads;
+    ::print_cfg = options.print_cfg;
+    ::print_inlining = options.print_inlining;
+    ::typecheck = options.typecheck;
+    ::optimize = options.optimize;
+    ::quads = options.quads;
+    ::assembler = options.assembler;
+    ::whole_program = options.whole_program;
+    ::cache_directory = options.cache_directory;
+}
+
+compilation_context *compilation_context::current() {
+    return current_context;
+}
+
+/* Runs the whole compiler on the program: yyparse() calls the scanner for
+   tokens, and the actions in parser.y take each block through the remaining
+   phases as soon as it has been parsed. The error count is kept per thread,
+   so it's only this compilation's while it runs. Imported interfaces are
+   read first, since the parser enters them along with the program name, and
+   a unit's interface is written once the whole unit has compiled. When
+   profiling, the phases measure themselves, and what they don't cover is
+   put down to parsing. A fatal error ends the compilation where it was
+   found. */
+int compilation_context::compile(FILE *in) {
+    void *scanner;
+
+    activate();
+    error_count = 0;
+    double wall_start = wall_time_ms();
+    double cpu_start = cpu_time_ms();
+    long allocations_start = allocations_made();
+    long rss_start = peak_rss_kb();
+
+    for (size_t i = 0; i < options.imports.size(); i++) {
+        if (!units->read_interface(options.imports[i])) {
+            errors = error_count;
+            return errors;
+        }
+    }
+
+    yylex_init(&scanner);
+    yyset_in(in, scanner);
+    try {
+        yyparse(scanner);
+    } catch (fatal_error &) {
+        // Already reported and counted by fatal().
+    }
+    yylex_destroy(scanner);
+
+    if (!options.interface_file.empty() && error_count == 0) {
+        units->write_interface(options.interface_file);
+    }
+
+    if (measurements != NULL) {
+        measurements->finish(wall_time_ms() - wall_start, cpu_time_ms() - cpu_start,
+                             allocations_made() - allocations_start,
+                             peak_rss_kb() - rss_start);
+    }
+
+    errors = error_count;
+    return errors;
+}
+
+symbol_table *compilation_context::get_symbol_table() {
+    return symbols;
+}
+
+compile_profile *compilation_context::get_profile() {
+    return measurements;
+}
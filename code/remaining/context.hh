@@ -0,0 +1,119 @@
+#ifndef __CONTEXT_HH__
+#define __CONTEXT_HH__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <ostream>
+
+using namespace std;
+
+class symbol_table;
+class semantic;
+class ast_optimizer;
+class quad_optimizer;
+class call_summaries;
+class call_graph;
+class code_generator;
+class unit_linker;
+class compile_profile;
+
+/* The flags given to the 'diesel' script, see main.cc. */
+struct compile_options {
+    bool assembler_trace;
+    bool print_ast;
+    bool print_quads;
+    bool print_cfg;
+    bool print_inlining;
+    bool typecheck;
+    bool optimize;
+    bool quads;
+    bool assembler;
+    bool whole_program;
+    // Where generated code is cached, or empty for no cache.
+    string cache_directory;
+    // Interface files to import, and where to write the interface if the
+    // program is compiled as a unit (see unit.hh).
+    vector<string> imports;
+    string interface_file;
+    // Whether to measure the time and memory each phase takes (-T).
+    bool profile;
+
+    compile_options();
+};
+
+/* Everything a single compilation needs: the symbol table, the type checker,
+   the optimizers, the code generator with the file it writes to, and the
+   error count. The compiler's phases reach these through the globals sym_tab,
+   type_checker, optimizer, quad_opt, summaries, program_graph, code_gen,
+   linker and profile, and the flags through the globals below. All of them
+   are thread_local, and activate() points them to this compilation for the
+   calling thread. Since the scanner is reentrant and the parser pure,
+   several programs can then be compiled at the same time, one per thread,
+   each with a context of its own. A context is meant for compiling a single program. */
+class compilation_context {
+private:
+    compile_options options;
+
+    symbol_table *symbols;
+    semantic *checker;
+    ast_optimizer *ast_opt;
+    quad_optimizer *quad_optimization;
+    call_summaries *procedure_summaries;
+    call_graph *graph;
+    code_generator *generator;
+    unit_linker *units;
+    // NULL unless options.profile is set.
+    compile_profile *measurements;
+
+    // Where errors are printed.
+    ostream *messages;
+
+    // The errors found by compile().
+    int errors;
+
+public:
+    //! Arg 2 = filename of the assembler outfile.
+    compilation_context(const compile_options &, const string);
+
+    //! Arg 2 = stream to write the assembler code to, arg 3 = stream to
+    //! print errors on.
+    compilation_context(const compile_options &, ostream &, ostream &);
+
+    //! Closes the assembler outfile, if any.
+    ~compilation_context();
+
+    //! Make the globals of the calling thread refer to this compilation.
+    void activate();
+
+    //! The compilation the globals of the calling thread refer to.
+    static compilation_context *current();
+
+    //! Parse and compile a Diesel program. Returns the number of errors.
+    int compile(FILE *);
+
+    symbol_table *get_symbol_table();
+
+    //! Where the time went, if the compilation was profiled, or NULL.
+    compile_profile *get_profile();
+
+private:
+    // Build the parts other than the code generator.
+    void create();
+};
+
+/* The flags of the compilation running on this thread. Defined in
+   context.cc. */
+extern thread_local bool assembler_trace;
+extern thread_local bool print_ast;
+extern thread_local bool print_quads;
+extern thread_local bool print_cfg;
+extern thread_local bool print_inlining;
+extern thread_local bool typecheck;
+extern thread_local bool optimize;
+extern thread_local bool quads;
+extern thread_local bool assembler;
+extern thread_local bool whole_program;
+extern thread_local string cache_directory;
+
+#endif
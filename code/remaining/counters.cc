@@ -0,0 +1,68 @@
+#include "counters.hh"
+
+#ifdef COMPILER_COUNTERS
+
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+/* Zero-initialized, like every object with static storage. */
+compiler_counters counters;
+
+static const char *OP_NAMES[] = {
+    "q_rload",   "q_iload",   "q_inot",    "q_ruminus", "q_iuminus",
+    "q_rplus",   "q_iplus",   "q_rminus",  "q_iminus",  "q_ior",
+    "q_iand",    "q_rmult",   "q_imult",   "q_rdivide", "q_idivide",
+    "q_imod",    "q_req",     "q_ieq",     "q_rne",     "q_ine",
+    "q_rlt",     "q_ilt",     "q_rgt",     "q_igt",     "q_rstore",
+    "q_istore",  "q_rassign", "q_iassign", "q_call",    "q_tcall",
+    "q_rreturn", "q_ireturn", "q_lindex",  "q_rrindex", "q_irindex",
+    "q_rfetch",  "q_ifetch",  "q_itor",    "q_jmp",     "q_jmpf",
+    "q_jmpt",    "q_param",   "q_labl",    "q_nop",
+};
+static_assert(sizeof(OP_NAMES) / sizeof(OP_NAMES[0]) == q_nop + 1,
+              "OP_NAMES must have an entry for every op code");
+
+static void print_counters(ostream &o) {
+    long lookups = counters.lookups;
+    long probes = counters.probes;
+
+    o << "\nCompiler counters\n"
+      << "    symbol lookups          " << setw(12) << lookups << "\n"
+      << "    hash chain probes       " << setw(12) << probes;
+    if (lookups > 0) {
+        o << "  (" << setiosflags(ios::fixed) << setprecision(2)
+          << (double)probes / lookups << " per lookup)" << resetiosflags(ios::fixed);
+    }
+    o << "\n"
+      << "    string pool bytes       " << setw(12) << counters.pool_bytes << "\n"
+      << "    pool bytes copied       " << setw(12) << counters.pool_copied_bytes << "\n"
+      << "    temporaries             " << setw(12) << counters.temporaries << "\n";
+
+    long total_quads = 0;
+    long total_lines = 0;
+    o << "\n    " << left << setw(12) << "op code" << right << setw(12) << "quads"
+      << setw(16) << "asm lines" << "\n";
+    for (int i = 0; i <= q_nop; i++) {
+        long made = counters.quads[i];
+        long lines = counters.assembler_lines[i];
+        total_quads += made;
+        total_lines += lines;
+        if (made != 0 || lines != 0) {
+            o << "    " << left << setw(12) << OP_NAMES[i] << right << setw(12)
+              << made << setw(16) << lines << "\n";
+        }
+    }
+    o << "    " << left << setw(12) << "total" << right << setw(12) << total_quads
+      << setw(16) << total_lines << endl;
+}
+
+/* Prints the counters when the compiler exits, by way of its destructor. */
+static struct counter_report {
+    ~counter_report() {
+        print_counters(cerr);
+    }
+} report;
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef __COUNTERS_HH__
+#define __COUNTERS_HH__
+
+/* Counters of the compiler's internal work, for finding the programs that
+   are pathological for the symbol table or the code generator. They are
+   only compiled in when the compiler is built with
+
+       make CPPFLAGS=-DCOMPILER_COUNTERS
+
+   and are then printed on stderr when the compiler exits. In an ordinary
+   build COUNT() and COUNT_ADD() expand to nothing, so they cost nothing.
+   The counters are shared by all threads, and a compile server adds up
+   every compilation it has done. */
+
+#include <ostream>
+
+using namespace std;
+
+#ifdef COMPILER_COUNTERS
+
+#include <atomic>
+#include <streambuf>
+
+#include "quads.hh"
+
+struct compiler_counters {
+    // symbol_table::lookup_symbol() calls, and the hash chain entries they
+    // compared with.
+    atomic<long> lookups;
+    atomic<long> probes;
+
+    // Bytes put in the string pool, and bytes copied when it grew.
+    atomic<long> pool_bytes;
+    atomic<long> pool_copied_bytes;
+
+    // Temporaries made by gen_temp_var().
+    atomic<long> temporaries;
+
+    // Quads made, and the assembler lines expand() emitted for them, per op
+    // code.
+    atomic<long> quads[q_nop + 1];
+    atomic<long> assembler_lines[q_nop + 1];
+};
+
+extern compiler_counters counters;
+
+#define COUNT(counter) (counters.counter++)
+#define COUNT_ADD(counter, n) (counters.counter += (n))
+
+/* Counts the lines written to a stream while it exists, by passing what is
+   written on to the stream's own buffer. */
+class line_counter : public streambuf {
+private:
+    ostream &stream;
+    streambuf *target;
+    long count;
+
+protected:
+    int overflow(int c) {
+        if (c == traits_type::eof()) {
+            return traits_type::not_eof(c);
+        }
+        if (c == '\n') {
+            count++;
+        }
+        return target->sputc(c);
+    }
+
+    streamsize xsputn(const char *s, streamsize n) {
+        for (streamsize i = 0; i < n; i++) {
+            if (s[i] == '\n') {
+                count++;
+            }
+        }
+        return target->sputn(s, n);
+    }
+
+    int sync() {
+        return target->pubsync();
+    }
+
+public:
+    line_counter(ostream &o)
+        : stream(o),
+          target(o.rdbuf(this)),
+          count(0) {
+    }
+
+    ~line_counter() {
+        stream.rdbuf(target);
+    }
+
+    long lines() {
+        return count;
+    }
+};
+
+#else
+
+// The count is not evaluated, but keeps what it uses from being unused.
+#define COUNT(counter) ((void)0)
+#define COUNT_ADD(counter, n) ((void)sizeof(n))
+
+class line_counter {
+public:
+    line_counter(ostream &) {
+    }
+
+    long lines() {
+        return 0;
+    }
+};
+
+#endif
+
+#endif
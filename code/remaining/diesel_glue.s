@@ -11,6 +11,16 @@
 .align    8
 .global   main
 
+# The predefined routines are called by separately compiled units too (see
+# unit.hh in the compiler), so their labels are visible to the linker.
+.global   L0
+.global   L1
+.global   L2
+.global   L3
+.global   L4
+.global   L5
+.global   L6
+
 main: # this is where the process starts
 
     # As we only use truncation and no other rounding
@@ -22,10 +32,15 @@ main: # this is where the process starts
     fnstcw word ptr [rbp-8]
     or word ptr [rbp-8], 3072 # from FE_TOWARDZERO
     fldcw word ptr [rbp-8]
+    # The runtime's SSE arithmetic (see diesel_rts.c) rounds the same way,
+    # so that it gets the same results as the x87 code of a Diesel program.
+    stmxcsr dword ptr [rbp-8]
+    or dword ptr [rbp-8], 24576 # rounding control bits 13-14: toward zero
+    ldmxcsr dword ptr [rbp-8]
     leave
 
     enter 0, 0
-    call    L3        # L3 is the DIESEL main program label
+    call    L7        # L7 is the DIESEL main program label
     leave
     # Exit in a normal way.
     mov rax, 0
@@ -33,7 +48,7 @@ main: # this is where the process starts
 
 L0: # read function
     # Return value is in RAX
-    call    getchar
+    call    mygetchar    # in diesel_rts.o
     ret
 
 L1: # write procedure
@@ -51,3 +66,43 @@ L2: # trunc function
     mov rax, qword ptr [rbp-8]
     leave
     ret
+
+# The number I/O routines. The C functions are called with the stack
+# aligned to 16 bytes, as the ABI wants, which a Diesel call doesn't keep.
+# The argument is found above the return address, reals are passed to and
+# from C in xmm0, and Diesel gets a real result in rax.
+
+L3: # write_int procedure
+    push rbp
+    mov rbp, rsp
+    and rsp, -16
+    mov rdi, qword ptr [rbp+16]
+    call    mywriteint   # in diesel_rts.o
+    leave
+    ret
+
+L4: # write_real procedure
+    push rbp
+    mov rbp, rsp
+    and rsp, -16
+    movsd xmm0, qword ptr [rbp+16]
+    call    mywritereal  # in diesel_rts.o
+    leave
+    ret
+
+L5: # read_int function
+    push rbp
+    mov rbp, rsp
+    and rsp, -16
+    call    myreadint    # in diesel_rts.o
+    leave
+    ret
+
+L6: # read_real function
+    push rbp
+    mov rbp, rsp
+    and rsp, -16
+    call    myreadreal   # in diesel_rts.o
+    movq rax, xmm0
+    leave
+    ret
@@ -0,0 +1,210 @@
+/* dieselc, the client of the compile server (see server.hh). It does what
+   the diesel script does, but lets a running compiler, started with
+   './compiler -S socket', do the preprocessing and the compiling. Several
+   programs can be given at once, which are then compiled at the same time. */
+
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "protocol.hh"
+#include "driver.hh"
+
+using namespace std;
+
+// The flags given on the command line.
+static string socket_path = "diesel.sock";
+static string output;
+static bool no_binary = false;
+static bool lean = false;
+static vector<string> compiler_flags;
+static vector<string> sources;
+
+// Keeps the printouts of different programs apart.
+static mutex print_lock;
+
+static void usage(char *program_name) {
+    cerr << "Usage:\n"
+         << program_name
+         << " [-S socket] [-b] [-L] [-o outfile] [-cfpstw] [-C dir] [-I* -D* -U*]"
+         << " source.d ...\n"
+         << "Options:\n"
+         << "  -S socket         The socket the compiler was started with,\n"
+         << "                    diesel.sock if not given.\n"
+         << "  -b                Write the assembler code to outfile instead of\n"
+         << "                    making an executable.\n"
+         << "  -L                Make small static executables, as for the\n"
+         << "                    diesel script.\n"
+         << "  -o outfile        Place the result in outfile rather than a.out\n"
+         << "                    (or d.out with -b). With several sources, the\n"
+         << "                    result is named after each source instead.\n"
+         << "  -c -f -p -s -t -w -C, -I*, -D*, -U*\n"
+         << "                    As for the diesel script.\n";
+    exit(1);
+}
+
+/* Make a path absolute, since the server may have another working
+   directory. */
+static string absolute(const string &path) {
+    if (path.empty() || path[0] == '/') {
+        return path;
+    }
+    char *cwd = getcwd(NULL, 0);
+    string result = string(cwd) + "/" + path;
+    free(cwd);
+    return result;
+}
+
+static int connect_to_server() {
+    struct sockaddr_un address;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/* The name of the result, see usage(). */
+static string result_name(const string &source) {
+    if (sources.size() == 1) {
+        if (!output.empty()) {
+            return output;
+        }
+        return no_binary ? "d.out" : "a.out";
+    }
+    string name = source.substr(source.rfind('/') + 1);
+    if (name.size() > 2 && name.compare(name.size() - 2, 2, ".d") == 0) {
+        name.erase(name.size() - 2);
+    }
+    return no_binary ? name + ".s" : name;
+}
+
+/* Compile one source. Returns 0 if it went well. */
+static int build(int connection, const string &source) {
+    vector<string> args(compiler_flags);
+    args.push_back(absolute(source));
+
+    int status;
+    string code;
+    string messages;
+    if (!send_request(connection, args)
+        || !receive_reply(connection, status, code, messages)) {
+        lock_guard<mutex> guard(print_lock);
+        cerr << source << ": lost the connection to the compile server\n";
+        return 1;
+    }
+    if (!messages.empty()) {
+        lock_guard<mutex> guard(print_lock);
+        if (sources.size() > 1) {
+            cerr << source << ":\n";
+        }
+        cerr << messages << flush;
+    }
+    if (status != 0 || code.empty()) {
+        return status;
+    }
+
+    string result = result_name(source);
+    if (no_binary) {
+        ofstream file(result.c_str());
+        file << code;
+        return file ? 0 : 1;
+    }
+    return assemble_and_link(code, result, false, vector<string>(), lean) ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-S" || arg == "-o" || arg == "-C") {
+            if (i + 1 == argc) {
+                usage(argv[0]);
+            }
+            if (arg == "-S") {
+                socket_path = argv[++i];
+            } else if (arg == "-o") {
+                output = argv[++i];
+            } else {
+                compiler_flags.push_back(arg);
+                compiler_flags.push_back(absolute(argv[++i]));
+            }
+        } else if (arg == "-b") {
+            no_binary = true;
+        } else if (arg == "-L") {
+            lean = true;
+        } else if (arg == "-c" || arg == "-f" || arg == "-p" || arg == "-s"
+                   || arg == "-t" || arg == "-w") {
+            compiler_flags.push_back(arg);
+        } else if (arg.compare(0, 2, "-I") == 0) {
+            compiler_flags.push_back("-I" + absolute(arg.substr(2)));
+        } else if (arg.compare(0, 2, "-D") == 0 || arg.compare(0, 2, "-U") == 0) {
+            compiler_flags.push_back(arg);
+        } else if (arg[0] == '-') {
+            usage(argv[0]);
+        } else {
+            sources.push_back(arg);
+        }
+    }
+    if (sources.empty() || (sources.size() > 1 && !output.empty())) {
+        usage(argv[0]);
+    }
+
+    // One connection per worker. The server compiles the programs of
+    // different connections at the same time.
+    unsigned workers = thread::hardware_concurrency();
+    if (workers == 0) {
+        workers = 1;
+    }
+    if (workers > sources.size()) {
+        workers = sources.size();
+    }
+    atomic<size_t> next(0);
+    atomic<int> failed(0);
+
+    auto work = [&]() {
+        int connection = connect_to_server();
+        if (connection < 0) {
+            lock_guard<mutex> guard(print_lock);
+            cerr << "Could not connect to the compile server on " << socket_path
+                 << ". (Did you start './compiler -S " << socket_path
+                 << "'?)\n";
+            failed++;
+            return;
+        }
+        for (size_t i = next++; i < sources.size(); i = next++) {
+            if (build(connection, sources[i]) != 0) {
+                failed++;
+            }
+        }
+        close(connection);
+    };
+
+    vector<thread> pool;
+    for (unsigned i = 0; i < workers; i++) {
+        pool.push_back(thread(work));
+    }
+    for (size_t i = 0; i < pool.size(); i++) {
+        pool[i].join();
+    }
+
+    // The number of programs that failed.
+    exit(failed);
+}
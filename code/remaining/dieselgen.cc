@@ -0,0 +1,213 @@
+/* dieselgen writes a synthetic Diesel program to stdout, for finding out how
+   the compiler scales (see the scaling script). The program's size is set
+   along independent axes, each by a flag:
+
+     -p procs      The number of functions declared in the main program.
+     -n depth      How deeply functions are nested in each of them. Each
+                   level declares the next one, down to depth levels.
+     -l locals     The number of local variables in each scope, the main
+                   program's included.
+     -e depth      How deeply each expression is nested.
+     -c consts     The number of integer constants in the main program.
+     -s strings    The number of string constants in the main program.
+     -L length     The length of each string constant.
+
+   The programs are valid, and always compile when the compiler's limits
+   allow, but aren't meant to be run: nothing is printed. Every function
+   assigns each of its locals an expression, calls the function nested in
+   it, and returns a sum, and the main program calls every function. The
+   names are made up from the function's position, so no two programs with
+   the same flags differ. */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+
+// The flags given on the command line.
+static int procedures = 4;
+static int nesting = 1;
+static int locals = 4;
+static int expression_depth = 4;
+static int constants = 4;
+static int strings = 0;
+static int string_length = 16;
+
+static void usage(char *program_name) {
+    cerr << "Usage:\n"
+         << program_name << " [-p procs] [-n depth] [-l locals] [-e depth]"
+         << " [-c consts] [-s strings] [-L length]\n"
+         << "Options:\n"
+         << "  -p procs          Functions in the main program (4).\n"
+         << "  -n depth          Nesting depth of functions (1).\n"
+         << "  -l locals         Local variables per scope (4).\n"
+         << "  -e depth          Nesting depth of expressions (4).\n"
+         << "  -c consts         Integer constants (4).\n"
+         << "  -s strings        String constants (0).\n"
+         << "  -L length         Length of each string constant (16).\n";
+    exit(1);
+}
+
+static string indent(int level) {
+    return string(4 * level, ' ');
+}
+
+/* The name of the function at nesting level 'level' in function 'proc'. */
+static string function_name(int proc, int level) {
+    ostringstream name;
+    name << "f" << proc << "_" << level;
+    return name.str();
+}
+
+/* The name of local 'nr' of the scope at 'level' (0 for the main program). */
+static string local_name(int level, int nr) {
+    ostringstream name;
+    name << "v" << level << "_" << nr;
+    return name.str();
+}
+
+/* An operand for an expression in a function at 'level': one of its own
+   locals, its parameter, a local of the enclosing scope, or a constant. */
+static string operand(int level, int nr) {
+    ostringstream result;
+    switch (nr % 4) {
+    case 0:
+        if (locals > 0) {
+            return local_name(level, nr % locals);
+        }
+        return "x";
+    case 1:
+        return "x";
+    case 2:
+        if (locals > 0) {
+            return local_name(level - 1, nr % locals);
+        }
+        return "x";
+    default:
+        if (constants > 0) {
+            result << "c" << nr % constants;
+        } else {
+            result << nr;
+        }
+        return result.str();
+    }
+}
+
+/* An expression nested 'depth' levels deep, as a chain of parenthesized
+   binary operations. */
+static string expression(int level, int seed, int depth) {
+    static const char *OPERATORS[] = { " + ", " - ", " * " };
+    string result = operand(level, seed);
+    for (int i = 0; i < depth; i++) {
+        result = "(" + operand(level, seed + i + 1) + OPERATORS[(seed + i) % 3]
+                 + result + ")";
+    }
+    return result;
+}
+
+/* The locals of the scope at 'level', declared at indentation 'column'. */
+static void write_locals(int level, int column) {
+    for (int i = 0; i < locals; i++) {
+        cout << indent(column) << local_name(level, i) << " : integer;\n";
+    }
+}
+
+/* Writes function number 'proc' at nesting level 'level' (which is also
+   its block level), and the functions nested in it. */
+static void write_function(int proc, int level) {
+    string name = function_name(proc, level);
+    cout << indent(level - 1) << "function " << name << "(x : integer) : integer;\n";
+    if (locals > 0) {
+        cout << indent(level - 1) << "var\n";
+        write_locals(level, level);
+    }
+    if (level < nesting) {
+        write_function(proc, level + 1);
+    }
+    cout << indent(level - 1) << "begin\n";
+    for (int i = 0; i < locals; i++) {
+        cout << indent(level) << local_name(level, i) << " := "
+             << expression(level, proc + i, expression_depth) << ";\n";
+    }
+    cout << indent(level) << "return ";
+    if (level < nesting) {
+        cout << function_name(proc, level + 1) << "(x) + ";
+    }
+    cout << expression(level, proc, expression_depth) << ";\n";
+    cout << indent(level - 1) << "end;\n";
+}
+
+int main(int argc, char **argv) {
+    int option;
+    while ((option = getopt(argc, argv, "p:n:l:e:c:s:L:h?")) != EOF) {
+        int value = optarg != NULL ? atoi(optarg) : 0;
+        switch (option) {
+        case 'p':
+            procedures = value;
+            break;
+        case 'n':
+            nesting = value;
+            break;
+        case 'l':
+            locals = value;
+            break;
+        case 'e':
+            expression_depth = value;
+            break;
+        case 'c':
+            constants = value;
+            break;
+        case 's':
+            strings = value;
+            break;
+        case 'L':
+            string_length = value;
+            break;
+        default:
+            usage(argv[0]);
+        }
+        if (value < 0) {
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc || nesting < 1 || string_length < 1) {
+        usage(argv[0]);
+    }
+
+    cout << "program generated;\n";
+    if (constants > 0 || strings > 0) {
+        cout << "const\n";
+    }
+    for (int i = 0; i < constants; i++) {
+        cout << indent(1) << "c" << i << " = " << i + 1 << ";\n";
+    }
+    for (int i = 0; i < strings; i++) {
+        cout << indent(1) << "s" << i << " = '";
+        for (int j = 0; j < string_length; j++) {
+            cout << (char)('a' + (i + j) % 26);
+        }
+        cout << "';\n";
+    }
+    cout << "var\n";
+    write_locals(0, 1);
+    cout << indent(1) << "total : integer;\n";
+
+    for (int proc = 0; proc < procedures; proc++) {
+        write_function(proc, 1);
+    }
+
+    cout << "begin\n";
+    cout << indent(1) << "total := 0;\n";
+    for (int i = 0; i < locals; i++) {
+        cout << indent(1) << local_name(0, i) << " := " << i << ";\n";
+    }
+    for (int proc = 0; proc < procedures; proc++) {
+        cout << indent(1) << "total := total + " << function_name(proc, 1) << "("
+             << proc << ");\n";
+    }
+    cout << "end.\n";
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include "driver.hh"
+
+using namespace std;
+
+extern char **environ;
+
+bool read_whole_file(const string &path, string &text) {
+    ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+    ostringstream contents;
+    contents << file.rdbuf();
+    text = contents.str();
+    return true;
+}
+
+/* The diesel script ran 'as' and 'gcc' on temporary files. Here gcc is
+   given the assembler code directly and passes the flags on to 'as'. The
+   code still has to go through a file, since gcc can't read assembler code
+   from a pipe and link at the same time. Without link, gcc only assembles
+   the code into an object file, and objects is empty. */
+static bool run_gcc(const string &code, const string &output, bool debug,
+                    bool link, const vector<string> &objects, bool lean) {
+    char name[] = "/tmp/diesel-XXXXXXXXXX.s";
+    int fd = mkstemps(name, 2);
+    if (fd < 0) {
+        perror("mkstemps");
+        return false;
+    }
+    bool written = write(fd, code.data(), code.size()) == (ssize_t)code.size();
+    close(fd);
+    if (!written) {
+        cerr << "Could not write " << name << endl;
+        unlink(name);
+        return false;
+    }
+
+    vector<const char *> args;
+    args.push_back("gcc");
+    if (link) {
+        args.push_back("-fno-pie");
+        args.push_back("-no-pie");
+        if (lean) {
+            args.push_back("-static");
+            args.push_back("-nostdlib");
+        }
+    } else {
+        args.push_back("-c");
+    }
+    args.push_back(debug ? "-Wa,--64,--march=generic64+8087,--gstabs"
+                         : "-Wa,--64,--march=generic64+8087");
+    args.push_back("-o");
+    args.push_back(output.c_str());
+    args.push_back(name);
+    for (size_t i = 0; i < objects.size(); i++) {
+        args.push_back(objects[i].c_str());
+    }
+    if (link) {
+        args.push_back(lean ? "diesel_rts_lean.o" : "diesel_rts.o");
+    }
+    args.push_back(NULL);
+
+    pid_t pid;
+    int status = 1;
+    if (posix_spawnp(&pid, "gcc", NULL, NULL, (char **)&args[0], environ) != 0) {
+        perror("gcc");
+    } else {
+        waitpid(pid, &status, 0);
+    }
+    unlink(name);
+
+    if (status != 0) {
+        cerr << "The assembler code is causing the errors!" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool assemble_and_link(const string &code, const string &executable,
+                       bool debug, const vector<string> &objects, bool lean) {
+    return run_gcc(code, executable, debug, true, objects, lean);
+}
+
+bool assemble(const string &code, const string &object, bool debug) {
+    return run_gcc(code, object, debug, false, vector<string>(), false);
+}
@@ -0,0 +1,33 @@
+#ifndef __DRIVER_HH__
+#define __DRIVER_HH__
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Turning the assembler code of a program into an executable, the way the
+   diesel script used to: the code goes after diesel_glue.s, and the result
+   is assembled and linked with the run-time system in diesel_rts.o. Both
+   files are taken from the working directory. Used by main.cc and by the
+   compile server and its client. */
+
+//! Read a whole file into arg 2. Returns false if it couldn't be opened.
+bool read_whole_file(const string &, string &);
+
+//! Assemble and link arg 1, which should start with diesel_glue.s, into the
+//! executable named by arg 2. Only gcc is started, which runs the assembler
+//! and the linker. If arg 3 is true, line numbers of the assembler code are
+//! included for gdb. Arg 4 are object files of separately compiled units to
+//! link in (see unit.hh). If arg 5 is true, the executable is linked
+//! statically with diesel_rts_lean.o instead, without the C library.
+//! Returns false, having printed why, if it failed.
+bool assemble_and_link(const string &, const string &, bool,
+                       const vector<string> &objects = vector<string>(),
+                       bool lean = false);
+
+//! Assemble arg 1, the code of a unit, into the object file named by arg 2.
+//! Arg 3 is as above.
+bool assemble(const string &, const string &, bool);
+
+#endif
@@ -8,12 +8,16 @@
    isn't really necessary - bison provides the yynerrs variable which counts
    errors, right? - Yes, but we also want to keep track of semantic errors
    and the like, which bison can't detect. */
-int error_count = 0;
+thread_local int error_count = 0;
+
+/* Errors and debug output are written here. A compile server sends them
+   back to the client that asked for the compilation instead. */
+thread_local ostream *error_stream = &cerr;
 
 /* General error outstream. */
 ostream &error(string header) {
     error_count++;
-    return cerr << header;
+    return *error_stream << header;
 }
 
 /* Error outstream with position information given. */
@@ -22,19 +26,21 @@ ostream &error(position_information *pos) {
                           << ", col " << pos->get_column() << ": ";
 }
 
-/* Abort program with error message. */
+/* Abort compiling with error message. The error is counted, so the
+   compilation fails. */
 void fatal(string msg) {
     error() << "Fatal: " << msg << endl
             << flush;
-    abort();
+    throw fatal_error(msg);
 }
 
 /* Used for parser errors. Bison uses this for parse errors not caught by
    the grammar, so it's useful to at least include the line number. Since
    the error is not one we've accounted for, we don't have access to any
-   position_information. NOTE: Fix scanner.l so it catches weird syntax? */
-void yyerror(string msg) {
-    error() << "line " << yylineno << ": " << msg << endl
+   position_information, but the scanner knows the line. NOTE: Fix
+   scanner.l so it catches weird syntax? */
+void yyerror(int line, string msg) {
+    error() << "line " << line << ": " << msg << endl
             << flush;
 }
 
@@ -55,7 +61,7 @@ ostream &type_error(position_information *pos) {
 
 /* General trace print function, used for debugging. */
 ostream &debug(string header) {
-    return cerr << header;
+    return *error_stream << header;
 }
 
 /* General trace print function, used for debugging. */
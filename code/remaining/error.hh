@@ -4,6 +4,7 @@
 #include <iostream>
 #include <sstream>
 #include <ostream>
+#include <stdexcept>
 
 using namespace std;
 
@@ -11,11 +12,12 @@ using namespace std;
      classes and files. Breaking the OO paradigm for the sake of convenience...
      So sue me. ***/
 
-// Defined in error.cc.
-extern int error_count;
+// Defined in error.cc. Each thread counts the errors of the compilation it
+// is running, see context.hh.
+extern thread_local int error_count;
 
-// Defined in scanner.cc (the generated file)
-extern int yylineno;
+// Where the routines below print, per thread. Normally cerr, see context.hh.
+extern thread_local ostream *error_stream;
 
 /* This class contains (starting) line and column of a token, and is used to
    report the positions of errors in the code. */
@@ -38,11 +40,22 @@ public:
 /* Various methods for printing things, with or without position info.
    They are all defined for real in error.cc. */
 
-//! Prints message, aborts compiling.
+/* Thrown by fatal(). compilation_context::compile() catches it, so a fatal
+   error ends the compilation but not the process running it, which may be
+   a compile server. */
+class fatal_error : public runtime_error {
+public:
+    fatal_error(const string &msg)
+        : runtime_error(msg) {
+    }
+};
+
+//! Prints message, aborts compiling by throwing a fatal_error.
 extern void fatal(string);
 
-//! This must be defined (for ``flex``), but using ``error(pos) << "foo"`` is preferable.
-extern void yyerror(string);
+//! Used by the scanner and the parser, which pass the line the error was found
+//! on. Using ``error(pos) << "foo"`` is preferable.
+extern void yyerror(int, string);
 
 extern ostream &error(string header = "Error: ");
 
@@ -1,4 +1,8 @@
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,43 +10,183 @@
 
 #include "ast.hh"
 #include "parser.hh"
+#include "context.hh"
+#include "server.hh"
+#include "preprocess.hh"
+#include "driver.hh"
+#include "profile.hh"
 
 using namespace std;
 
-extern int error_count;
 extern bool yydebug;
-bool assembler_trace = false;
-bool print_ast = false;
-bool print_quads = false;
-bool typecheck = true;
-bool optimize = true;
-bool quads = true;
-bool assembler = true;
 
 void usage(char *program_name) {
     cerr << "Usage:\n"
-         << program_name << " [-acdfpqsty] inputfile\n"
+         << program_name << " [-acdfgipqsTtwy] [-C dir] [-J file]"
+         << " [-l interface] [-u interface] inputfile\n"
+         << program_name << " [-acdfgiLpqsTtwxy] [-C dir] [-J file]"
+         << " [-l interface] [-u interface] [-b] -o outfile [-I* -D* -U*]"
+         << " source.d [unit.o ...]\n"
+         << program_name << " -S socket\n"
          << program_name << " [-h?]\n"
          << "Options:\n"
          << "  -h, -?            Shows this message.\n"
          << "  -a                Print AST (abstract syntax tree).\n"
+         << "  -b                Write the assembler code to outfile instead of\n"
+         << "                    making an executable.\n"
          << "  -c                Disable type checking.\n"
+         << "  -C dir            Cache the optimized quads and assembler code of\n"
+         << "                    each block in dir, and reuse them when the\n"
+         << "                    block hasn't changed.\n"
          << "  -d                Turn on parser debugging.\n"
          << "  -f                Don't optimize.\n"
+         << "  -g                Print control flow graphs.\n"
+         << "  -i                Report the calls that were inlined.\n"
+         << "  -J file           Write the profile of -T to file as JSON.\n"
+         << "  -l interface      Import the procedures and functions of a unit\n"
+         << "                    compiled with -u. Its object file is given\n"
+         << "                    after the source.\n"
+         << "  -L                Make a small static executable that starts\n"
+         << "                    faster, with the run-time system of\n"
+         << "                    diesel_rts_lean.o and without the C library.\n"
+         << "  -o outfile        Preprocess the source, compile it and make an\n"
+         << "                    executable (or assembler code with -b) named\n"
+         << "                    outfile. Without -o, the preprocessed program\n"
+         << "                    is read and the assembler code written to d.out.\n"
          << "  -p                Don't generate quads.\n"
          << "  -q                Print quad lists.\n"
          << "  -s                Don't generate assembler code.\n"
+         << "  -S socket         Run as a compile server on a Unix domain socket,\n"
+         << "                    see dieselc.\n"
          << "  -t                Include trace printouts in assembler code.\n"
-         << "  -y                Print symbol table.\n";
+         << "  -T                Print the time, allocations and memory growth\n"
+         << "                    of each phase of the compiler, and per block,\n"
+         << "                    and the peak memory use.\n"
+         << "  -u interface      Compile a unit: write the signatures of its\n"
+         << "                    procedures and functions to interface, and,\n"
+         << "                    with -o, make an object file.\n"
+         << "  -w                Compile the whole program before generating\n"
+         << "                    assembler, leaving out uncalled procedures.\n"
+         << "  -x                Include assembler line numbers in the executable\n"
+         << "                    for gdb, and print the numbered assembler code.\n"
+         << "  -y                Print symbol table.\n"
+         << "  -I*, -D*, -U*     Passed on to the preprocessor.\n";
     exit(1);
 }
 
+/* Print the symbol table, as the -y flag asks. */
+static void print_symbol_table(compilation_context *context) {
+    context->get_symbol_table()->print(2);
+    context->get_symbol_table()->print(1);
+}
+
+/* Print the profile of a compilation, as the -T flag asks, and write it to
+   json_file unless that is empty. */
+static void print_profile(compilation_context *context, const string json_file) {
+    compile_profile *profile = context->get_profile();
+    if (profile == NULL) {
+        return;
+    }
+    profile->print(cout);
+    if (!json_file.empty()) {
+        ofstream file(json_file.c_str());
+        profile->print_json(file);
+        if (!file) {
+            perror(json_file.c_str());
+        }
+    }
+}
+
+/* What the diesel script used to do: preprocess the source, compile it,
+   and assemble and link the code into an executable. Here everything but
+   the assembling and linking is done in the compiler, which writes only
+   the file asked for. A unit is only assembled, and the objects of the
+   units a program uses are linked with it. Returns the exit status. */
+static int build(const compile_options &flags, const string source,
+                 const vector<string> &cpp_options, const string output,
+                 const vector<string> &objects, bool no_binary,
+                 bool assembler_debug, bool lean, bool print_symtab,
+                 const string profile_json) {
+    string program;
+    preprocessor includes;
+    if (!includes.preprocess(source, cpp_options, program)) {
+        return 1;
+    }
+    // fmemopen() can't open an empty buffer.
+    if (program.empty()) {
+        program = "\n";
+    }
+    FILE *in = fmemopen(&program[0], program.size(), "r");
+    if (in == NULL) {
+        perror("fmemopen");
+        return 1;
+    }
+
+    ostringstream code;
+    compilation_context *context = new compilation_context(flags, code, cerr);
+    int errors = context->compile(in);
+    if (print_symtab) {
+        print_symbol_table(context);
+    }
+    print_profile(context, profile_json);
+    delete context;
+    fclose(in);
+
+    if (errors != 0) {
+        return errors;
+    }
+    // Nothing to write if the -p or -s flags stopped the compiler early.
+    if (code.str().empty()) {
+        return 0;
+    }
+
+    if (no_binary) {
+        ofstream file(output.c_str());
+        file << code.str();
+        if (!file) {
+            perror(output.c_str());
+            return 1;
+        }
+        return 0;
+    }
+
+    // A unit goes without diesel_glue.s, which would otherwise have switched
+    // the assembler to the syntax the code is written in.
+    if (!flags.interface_file.empty()) {
+        return assemble(".intel_syntax noprefix\n" + code.str(), output,
+                        assembler_debug) ? 0 : 1;
+    }
+
+    string glue;
+    if (!read_whole_file("diesel_glue.s", glue)) {
+        perror("diesel_glue.s");
+        return 1;
+    }
+    string assembler = glue + code.str();
+    if (assembler_debug) {
+        istringstream lines(assembler);
+        string line;
+        for (int nr = 1; getline(lines, line); nr++) {
+            cout << setw(6) << nr << "\t" << line << "\n";
+        }
+        cout << flush;
+    }
+    return assemble_and_link(assembler, output, assembler_debug, objects, lean) ? 0 : 1;
+}
+
 int main(int argc, char **argv) {
-    char options[] = "acdfpqstyh?";
+    char options[] = "abcC:dfgiJ:l:Lo:pqsS:tTu:wxyI:D:U:h?";
     int option;
     bool print_symtab = false;
-
-    extern FILE *yyin;
+    char *server_socket = NULL;
+    char *output = NULL;
+    bool no_binary = false;
+    bool assembler_debug = false;
+    bool lean = false;
+    string profile_json;
+    vector<string> cpp_options;
+    compile_options flags;
+    FILE *in;
 
     opterr = 0;
     optopt = '?';
@@ -53,12 +197,18 @@ int main(int argc, char **argv) {
         case 'a':
             cout << "An AST will be printed for each block.\n"
                  << flush;
-            print_ast = true;
+            flags.print_ast = true;
+            break;
+        case 'b':
+            no_binary = true;
             break;
         case 'c':
             cout << "No type checking will be performed.\n"
                  << flush;
-            typecheck = false;
+            flags.typecheck = false;
+            break;
+        case 'C':
+            flags.cache_directory = optarg;
             break;
         case 'd':
             cout << "Bison debugging turned on.\n"
@@ -68,27 +218,73 @@ int main(int argc, char **argv) {
         case 'f':
             cout << "No optimization will be done.\n"
                  << flush;
-            optimize = false;
+            flags.optimize = false;
+            break;
+        case 'g':
+            cout << "A control flow graph will be printed for each block.\n"
+                 << flush;
+            flags.print_cfg = true;
+            break;
+        case 'i':
+            cout << "Inlined calls will be reported.\n"
+                 << flush;
+            flags.print_inlining = true;
+            break;
+        case 'J':
+            profile_json = optarg;
+            flags.profile = true;
+            break;
+        case 'l':
+            flags.imports.push_back(optarg);
+            break;
+        case 'L':
+            lean = true;
+            break;
+        case 'o':
+            output = optarg;
             break;
         case 'p':
             cout << "No quads will be generated.\n"
                  << flush;
-            quads = false;
+            flags.quads = false;
             break;
         case 'q':
             cout << "A quad list will be printed for each block.\n"
                  << flush;
-            print_quads = true;
+            flags.print_quads = true;
             break;
         case 's':
             cout << "No assembler code will be generated.\n"
                  << flush;
-            assembler = false;
+            flags.assembler = false;
+            break;
+        case 'S':
+            server_socket = optarg;
             break;
         case 't':
             cout << "Assembler code will contain quad labels.\n"
                  << flush;
-            assembler_trace = true;
+            flags.assembler_trace = true;
+            break;
+        case 'T':
+            flags.profile = true;
+            break;
+        case 'u':
+            flags.interface_file = optarg;
+            break;
+        case 'w':
+            cout << "Only procedures called from the main program will be "
+                 << "compiled to assembler.\n"
+                 << flush;
+            flags.whole_program = true;
+            break;
+        case 'x':
+            assembler_debug = true;
+            break;
+        case 'I':
+        case 'D':
+        case 'U':
+            cpp_options.push_back(string("-") + (char)option + optarg);
             break;
         case 'y':
             cout << "Symbol table will be printed after compilation.\n";
@@ -103,29 +299,59 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (server_socket != NULL) {
+        if (optind != argc) {
+            usage(argv[0]);
+        }
+        compile_server server(server_socket, "diesel_glue.s");
+        server.run();
+        exit(1);
+    }
+
+    // All of a unit's procedures are there for other programs, whether its
+    // own main program calls them or not.
+    if (flags.whole_program && !flags.interface_file.empty()) {
+        usage(argv[0]);
+    }
+
+    if (output != NULL) {
+        if (optind == argc) {
+            usage(argv[0]);
+        }
+        vector<string> objects(argv + optind + 1, argv + argc);
+        if (!objects.empty() && !flags.interface_file.empty()) {
+            usage(argv[0]);
+        }
+        exit(build(flags, argv[optind], cpp_options, output, objects,
+                   no_binary, assembler_debug, lean, print_symtab, profile_json));
+    }
+
     if (optind > argc || optind < argc - 1) {
         usage(argv[0]);
     } else if (optind == argc) {
-        yyin = stdin;
+        in = stdin;
     } else {
-        yyin = fopen(argv[optind], "r");
-        if (yyin == NULL) {
+        in = fopen(argv[optind], "r");
+        if (in == NULL) {
             perror(argv[optind]);
             exit(1);
         }
     }
 
-    // Start the compilation. This is where all the magic is done.
-    // This function resides in parser.cc, which is generated by bison from
-    // parser.y.
-    yyparse();
+    // Start the compilation. This is where all the magic is done. The
+    // context holds everything the compilation needs, see context.hh, and
+    // compile() calls yyparse(), which resides in parser.cc, generated by
+    // bison from parser.y.
+    compilation_context *context = new compilation_context(flags, "d.out");
+    int errors = context->compile(in);
 
     // If given the appropriate flag, prints the symbol table after the input
     // has been parsed.
     if (print_symtab) {
-        sym_tab->print(2);
-        sym_tab->print(1);
+        print_symbol_table(context);
     }
+    print_profile(context, profile_json);
 
-    exit(error_count);
+    delete context;
+    exit(errors);
 }
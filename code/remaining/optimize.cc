@@ -6,7 +6,8 @@
      in the AST. If a more powerful AST optimization scheme were to be
      implemented, only methods in this file should need to be changed. ***/
 
-ast_optimizer *optimizer = new ast_optimizer();
+// Set by compilation_context::activate(), see context.hh.
+thread_local ast_optimizer *optimizer = NULL;
 
 /* The optimizer's interface method. Starts a recursive optimize call down
    the AST nodes, searching for binary operators with constant children. */
@@ -126,6 +127,7 @@ T do_binop(T left, T right, ast_node_type tag) {
         return (T)((bool)left) && ((bool)right);
     case AST_MULT:
         return left * right;
+    case AST_DIVIDE:
     case AST_IDIV:
         return left / right;
     case AST_MOD:
@@ -144,6 +146,17 @@ T do_binop(T left, T right, ast_node_type tag) {
     }
 }
 
+/* A named constant is replaced by its value so that the expression it is
+   in can be folded. If that can't be done, the constant is put back, since
+   its value would need a temporary to be loaded into, while the code
+   generator can use the constant as it is. */
+static ast_expression *unfolded(ast_expression *folded, ast_expression *original) {
+    if (original->tag == AST_ID && (folded->get_ast_integer() || folded->get_ast_real())) {
+        return original;
+    }
+    return folded;
+}
+
 template <typename T>
 ast_expression *fold_constants_binaryop(ast_expression *node) {
     T *binop_node = dynamic_cast<T *>(node);
@@ -152,8 +165,6 @@ ast_expression *fold_constants_binaryop(ast_expression *node) {
     }
     ast_expression *left_node = optimizer->fold_constants(binop_node->left);
     ast_expression *right_node = optimizer->fold_constants(binop_node->right);
-    binop_node->left = left_node;
-    binop_node->right = right_node;
 
     if (left_node->get_ast_integer() && right_node->get_ast_integer()) {
         int left = left_node->get_ast_integer()->value;
@@ -165,9 +176,16 @@ ast_expression *fold_constants_binaryop(ast_expression *node) {
         double left = left_node->get_ast_real()->value;
         double right = right_node->get_ast_real()->value;
         double ret = do_binop(left, right, node->tag);
+        // A relation is an integer, 0 or 1, whatever it compares.
+        if (dynamic_cast<ast_binaryrelation *>(node) != NULL) {
+            return new ast_integer(node->pos, (int)ret);
+        }
         return new ast_real(node->pos, ret);
     }
-    // TODO[et]: Do cast?
+    // Mixed integer and real operands have been cast to real by the
+    // type checker, and the casts of integer constants are folded below.
+    binop_node->left = unfolded(left_node, binop_node->left);
+    binop_node->right = unfolded(right_node, binop_node->right);
     return node;
 }
 
@@ -206,6 +224,14 @@ ast_expression *ast_optimizer::fold_constants(ast_expression *node) {
         if (new_node->get_ast_integer()) {
             return new ast_integer(new_node->pos, !new_node->get_ast_integer()->value);
         }
+    } else if (node->tag == AST_CAST) {
+        /* An integer constant cast to real becomes a real constant, so
+           expressions mixing the two can be folded further up. */
+        auto *new_node = dynamic_cast<ast_cast *>(node);
+        new_node->expr = optimizer->fold_constants(new_node->expr);
+        if (new_node->expr->get_ast_integer()) {
+            return new ast_real(new_node->pos, new_node->expr->get_ast_integer()->value);
+        }
     } else if (node->tag == AST_FUNCTIONCALL) {
         node->optimize();
     }
@@ -231,12 +257,16 @@ void ast_assign::optimize() {
 
 void ast_while::optimize() {
     condition->optimize();
-    body->optimize();
+    if (body) {
+        body->optimize();
+    }
 }
 
 void ast_if::optimize() {
     condition = optimizer->fold_constants(condition);
-    body->optimize();
+    if (body) {
+        body->optimize();
+    }
     if (elsif_list) {
         elsif_list->optimize();
     }
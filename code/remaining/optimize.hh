@@ -13,7 +13,7 @@
 class ast_optimizer;
 
 // Defined in optimize.cc.
-extern ast_optimizer *optimizer;
+extern thread_local ast_optimizer *optimizer;
 
 class ast_optimizer {
     /* You might want to add your own methods to this header file when
@@ -3,37 +3,30 @@
 #include "semantic.hh"
 #include "optimize.hh"
 #include "codegen.hh"
+#include "cfg.hh"
+#include "quadopt.hh"
+#include "callgraph.hh"
+#include "unit.hh"
+#include "profile.hh"
 
-/* Defined in parser.cc */
-extern char *yytext;
+#include "context.hh"
 
-/* Nr of errors encountered so far. Only generate quads & assembler if
-   error_count == 0. Defined in error.cc. */
-extern int error_count;
+/* The scanner is reentrant and the parser pure, so neither keeps any state
+   of its own between calls. The scanner handle is passed on to yyparse()
+   and from there to yylex(), see compilation_context::compile(). */
+typedef void *yyscan_t;
 
-/* Defined in symtab.cc. */
-extern symbol_table *sym_tab;
+/* Defined in scanner.cc (the generated file). */
+extern char *yyget_text(yyscan_t);
+extern int yyget_lineno(yyscan_t);
 
-/* Defined in semantic.cc. */
-extern semantic *type_checker;
+/* The text of the last token, used in error messages. */
+#define yytext yyget_text(scanner)
 
-/* Defined in codegen.cc. */
-extern code_generator *code_gen;
-
-/*! From scanner.l output. */
-extern int yylex();
-
-/* Defined in error.hh. */
-extern void yyerror(string);
-
-/* All these defined in main.cc. They represent some of the flags
-   given to the 'diesel' script. */
-extern bool print_ast;
-extern bool print_quads;
-extern bool typecheck;
-extern bool optimize;
-extern bool quads;
-extern bool assembler;
+/* The symbol table, type checker and code generator, as well as the nr of
+   errors encountered so far and the flags given to the 'diesel' script,
+   belong to the compilation running on this thread. See context.hh. Only
+   generate quads & assembler if error_count == 0. */
 
 #define YYDEBUG 1
 
@@ -117,6 +110,26 @@ extern bool assembler;
 
 %start program
 
+%define api.pure full
+%locations
+%parse-param {void *scanner}
+%lex-param {void *scanner}
+
+%code {
+/*! From scanner.l output. */
+extern int yylex(YYSTYPE *, YYLTYPE *, yyscan_t);
+
+/* With -T, the time spent in the scanner is measured token by token. */
+static int timed_yylex(YYSTYPE *lval, YYLTYPE *lloc, yyscan_t scanner) {
+    phase_timer timer(PHASE_SCAN, NULL);
+    return yylex(lval, lloc, scanner);
+}
+#define yylex timed_yylex
+
+/* Called by bison for syntax errors. Defined below. */
+void yyerror(YYLTYPE *, yyscan_t, const char *);
+}
+
 
 
 %%
@@ -132,6 +145,7 @@ program         : prog_decl subprog_part comp_stmt T_DOT
                     // passed to the compiler. See the 'diesel' script for
                     // more information.
                     if (typecheck) {
+                        phase_timer timer(PHASE_TYPECHECK, env);
                         type_checker->do_typecheck(env, $3);
                     }
 
@@ -141,7 +155,10 @@ program         : prog_decl subprog_part comp_stmt T_DOT
                     }
 
                     if (optimize) {
-                        optimizer->do_optimize($3);
+                        {
+                            phase_timer timer(PHASE_OPTIMIZE, env);
+                            optimizer->do_optimize($3);
+                        }
                         if(print_ast) {
                             cout << "\nOptimized AST for global level" << endl;
                             cout << (ast_stmt_list *)$3 << endl;
@@ -149,13 +166,37 @@ program         : prog_decl subprog_part comp_stmt T_DOT
                     }
                     if (error_count == 0) {
                         if (quads) {
-                            quad_list *q = $1->do_quads($3);
+                            quad_list *q;
+                            {
+                                phase_timer timer(PHASE_QUADS, env);
+                                q = $1->do_quads($3);
+                            }
+                            if (optimize) {
+                                phase_timer timer(PHASE_QUAD_OPTIMIZE, env);
+                                quad_opt->optimize(q, $1->sym_p);
+                            }
                             if (print_quads) {
                                 cout << "\nQuad list for global level" << endl;
                                 cout << (quad_list *)q << endl;
                             }
 
-                            if (assembler) {
+                            if (print_cfg) {
+                                control_flow_graph cfg(q, env);
+                                cout << "\nControl flow graph for global level"
+                                     << endl;
+                                cout << &cfg << endl;
+                            }
+
+                            if (whole_program) {
+                                program_graph->add(env, q);
+                                if (print_cfg) {
+                                    cout << "\nCall graph" << endl;
+                                    cout << program_graph << endl;
+                                }
+                                if (assembler) {
+                                    program_graph->generate_assembler(env);
+                                }
+                            } else if (assembler) {
                                 cout << "Generating assembler, global level"
                                      << endl;
                                 code_gen->generate_assembler(q, env);
@@ -183,6 +224,9 @@ prog_head       : T_PROGRAM T_IDENT
                 {
                     auto sym = sym_tab->enter_procedure(POS(@2), $2);
                     sym_tab->open_scope();
+                    // Procedures and functions imported from other units
+                    // are declared first, see unit.hh.
+                    linker->enter_imports(sym);
                     $$ = new ast_procedurehead(POS(@2), sym);
                 }
                 ;
@@ -325,6 +369,7 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                     symbol *env = sym_tab->get_symbol($1->sym_p);
 
                     if (typecheck) {
+                        phase_timer timer(PHASE_TYPECHECK, env);
                         type_checker->do_typecheck(env, $3);
                     }
 
@@ -336,7 +381,10 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                     }
 
                     if (optimize) {
-                        optimizer->do_optimize($3);
+                        {
+                            phase_timer timer(PHASE_OPTIMIZE, env);
+                            optimizer->do_optimize($3);
+                        }
                         if (print_ast) {
                             cout << "\nOptimized AST for \""
                                  << sym_tab->pool_lookup(env->id)
@@ -347,7 +395,15 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
 
                     if (error_count == 0) {
                         if (quads) {
-                            quad_list *q = $1->do_quads($3);
+                            quad_list *q;
+                            {
+                                phase_timer timer(PHASE_QUADS, env);
+                                q = $1->do_quads($3);
+                            }
+                            if (optimize) {
+                                phase_timer timer(PHASE_QUAD_OPTIMIZE, env);
+                                quad_opt->optimize(q, $1->sym_p);
+                            }
                             if (print_quads) {
                                 cout << "\nQuad list for \""
                                      << sym_tab->pool_lookup(env->id)
@@ -355,7 +411,19 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                                 cout << (quad_list *)q << endl;
                             }
 
-                            if (assembler) {
+                            if (print_cfg) {
+                                control_flow_graph cfg(q, env);
+                                cout << "\nControl flow graph for \""
+                                     << sym_tab->pool_lookup(env->id)
+                                     << "\"" << endl;
+                                cout << &cfg << endl;
+                            }
+
+                            if (whole_program) {
+                                // Translated when the main program is done,
+                                // if it is called at all.
+                                program_graph->add(env, q);
+                            } else if (assembler) {
                                 cout << "Generating assembler for procedure \""
                                      << sym_tab->pool_lookup(env->id)
                                      << "\"" << endl;
@@ -373,6 +441,7 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                     symbol *env = sym_tab->get_symbol($1->sym_p);
 
                     if (typecheck) {
+                        phase_timer timer(PHASE_TYPECHECK, env);
                         type_checker->do_typecheck(env, $3);
                     }
 
@@ -384,7 +453,10 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                     }
 
                     if (optimize) {
-                        optimizer->do_optimize($3);
+                        {
+                            phase_timer timer(PHASE_OPTIMIZE, env);
+                            optimizer->do_optimize($3);
+                        }
                         if (print_ast) {
                             cout << "\nOptimized AST for \""
                                  << sym_tab->pool_lookup(env->id)
@@ -395,7 +467,15 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
 
                     if (error_count == 0) {
                         if (quads) {
-                            quad_list *q = $1->do_quads($3);
+                            quad_list *q;
+                            {
+                                phase_timer timer(PHASE_QUADS, env);
+                                q = $1->do_quads($3);
+                            }
+                            if (optimize) {
+                                phase_timer timer(PHASE_QUAD_OPTIMIZE, env);
+                                quad_opt->optimize(q, $1->sym_p);
+                            }
                             if (print_quads) {
                                 cout << "\nQuad list for \""
                                      << sym_tab->pool_lookup(env->id)
@@ -403,7 +483,19 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                                 cout << (quad_list *)q << endl;
                             }
 
-                            if (assembler) {
+                            if (print_cfg) {
+                                control_flow_graph cfg(q, env);
+                                cout << "\nControl flow graph for \""
+                                     << sym_tab->pool_lookup(env->id)
+                                     << "\"" << endl;
+                                cout << &cfg << endl;
+                            }
+
+                            if (whole_program) {
+                                // Translated when the main program is done,
+                                // if it is called at all.
+                                program_graph->add(env, q);
+                            } else if (assembler) {
                                 cout << "Generating assembler for function \""
                                      << sym_tab->pool_lookup(env->id) << "\""
                                      << endl;
@@ -930,3 +1022,9 @@ id              : T_IDENT
 
 
 %%
+
+
+/* Report a syntax error at the line the scanner is at. */
+void yyerror(YYLTYPE *, yyscan_t scanner, const char *msg) {
+    yyerror(yyget_lineno(scanner), msg);
+}
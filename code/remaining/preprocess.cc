@@ -0,0 +1,224 @@
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "error.hh"
+#include "preprocess.hh"
+
+using namespace std;
+
+// How deeply files may include each other before we give up (and let cpp
+// report the loop).
+static const int MAX_INCLUDE_DEPTH = 200;
+
+// The way the diesel script runs cpp. -traditional-cpp keeps the whitespace
+// as it is, so the line numbers stay correct.
+static const string CPP_COMMAND = "cpp -traditional-cpp -C -P";
+
+preprocessor::preprocessor()
+    : cpp_header_lines(-1) {
+}
+
+/* Quote a string for the shell. */
+static string shell_quote(const string &s) {
+    string result = "'";
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '\'') {
+            result += "'\\''";
+        } else {
+            result += s[i];
+        }
+    }
+    return result + "'";
+}
+
+/* The directory part of a path, including the last slash. */
+static string directory_of(const string &path) {
+    size_t slash = path.rfind('/');
+    if (slash == string::npos) {
+        return "";
+    }
+    return path.substr(0, slash + 1);
+}
+
+/* If a line is a directive, ie, starts with a '#', returns true and stores
+   the name of the file in arg 2 if it's #include "file", or an empty
+   string if it's something else. */
+static bool is_directive(const string &line, string &included) {
+    size_t i = line.find_first_not_of(" \t");
+    if (i == string::npos || line[i] != '#') {
+        return false;
+    }
+    included = "";
+    i = line.find_first_not_of(" \t", i + 1);
+    if (i == string::npos || line.compare(i, 7, "include") != 0) {
+        return true;
+    }
+    i = line.find_first_not_of(" \t", i + 7);
+    if (i == string::npos || line[i] != '"') {
+        return true;
+    }
+    size_t end = line.find('"', i + 1);
+    if (end == string::npos || end == i + 1
+        || line.find_first_not_of(" \t\r", end + 1) != string::npos) {
+        return true;
+    }
+    included = line.substr(i + 1, end - i - 1);
+    return true;
+}
+
+bool preprocessor::read_file(const string &path, string &text) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+
+    lock_guard<mutex> guard(lock);
+    map<string, cached_file>::iterator cached = files.find(path);
+    if (cached != files.end() && cached->second.modified == info.st_mtime) {
+        text = cached->second.text;
+        return true;
+    }
+
+    ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+    ostringstream contents;
+    contents << file.rdbuf();
+    files[path].modified = info.st_mtime;
+    files[path].text = contents.str();
+    text = files[path].text;
+    return true;
+}
+
+/* Copies the text of a file, which has already been read, replacing the
+   #include lines by the files they name. */
+bool preprocessor::expand(const string &text, const vector<string> &dirs,
+                          string &result, int depth) {
+    if (depth > MAX_INCLUDE_DEPTH) {
+        return false;
+    }
+
+    istringstream lines(text);
+    string line;
+    while (getline(lines, line)) {
+        string included;
+        if (!is_directive(line, included)) {
+            result += line;
+            result += '\n';
+            continue;
+        }
+        if (included.empty()) {
+            return false;
+        }
+
+        string contents;
+        bool found = false;
+        for (size_t i = 0; i < dirs.size() && !found; i++) {
+            string path = included[0] == '/' ? included : dirs[i] + included;
+            if (read_file(path, contents)) {
+                vector<string> nested_dirs(dirs);
+                nested_dirs[0] = directory_of(path);
+                if (!expand(contents, nested_dirs, result, depth + 1)) {
+                    return false;
+                }
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool preprocessor::run_cpp(const string &path, const vector<string> &options,
+                           string &result) {
+    // cpp prints a header, whose length differs between versions, so we find
+    // out how long it is the first time, like the diesel script does.
+    {
+        lock_guard<mutex> guard(lock);
+        if (cpp_header_lines < 0) {
+            FILE *p = popen(("echo DIESELPROGRAM | " + CPP_COMMAND).c_str(), "r");
+            char buffer[1024];
+            cpp_header_lines = 0;
+            while (p != NULL && fgets(buffer, sizeof(buffer), p) != NULL) {
+                if (strstr(buffer, "DIESELPROGRAM") != NULL) {
+                    break;
+                }
+                cpp_header_lines++;
+            }
+            if (p != NULL) {
+                pclose(p);
+            }
+        }
+    }
+
+    string command = CPP_COMMAND;
+    for (size_t i = 0; i < options.size(); i++) {
+        command += " " + shell_quote(options[i]);
+    }
+    command += " " + shell_quote(path);
+
+    FILE *p = popen(command.c_str(), "r");
+    if (p == NULL) {
+        error() << "Could not run cpp on " << path << endl;
+        return false;
+    }
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), p)) > 0) {
+        result.append(buffer, n);
+    }
+    if (pclose(p) != 0) {
+        error() << "cpp failed on " << path << endl;
+        return false;
+    }
+
+    size_t start = 0;
+    for (int i = 0; i < cpp_header_lines && start != string::npos; i++) {
+        start = result.find('\n', start);
+        if (start != string::npos) {
+            start++;
+        }
+    }
+    result.erase(0, start == string::npos ? result.size() : start);
+    return true;
+}
+
+bool preprocessor::preprocess(const string &path, const vector<string> &options,
+                              string &result) {
+    // The first directory is the one of the file itself.
+    vector<string> dirs(1, directory_of(path));
+    bool plain = true;
+    for (size_t i = 0; i < options.size(); i++) {
+        if (options[i].compare(0, 2, "-I") == 0) {
+            string dir = options[i].substr(2);
+            if (!dir.empty() && dir[dir.size() - 1] != '/') {
+                dir += '/';
+            }
+            dirs.push_back(dir);
+        } else {
+            plain = false;
+        }
+    }
+
+    // The source file itself isn't cached, it's the one being worked on.
+    ifstream file(path.c_str());
+    if (!file) {
+        error() << "Could not open " << path << endl;
+        return false;
+    }
+    ostringstream contents;
+    contents << file.rdbuf();
+
+    result = "";
+    if (plain && expand(contents.str(), dirs, result, 0)) {
+        return true;
+    }
+    result = "";
+    return run_cpp(path, options, result);
+}
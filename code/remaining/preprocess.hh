@@ -0,0 +1,57 @@
+#ifndef __PREPROCESS_HH__
+#define __PREPROCESS_HH__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <time.h>
+
+using namespace std;
+
+/* Preprocessing of Diesel source files. The programs only use cpp to
+   #include other Diesel files, such as stdio.d, so that is done here
+   without starting cpp: an #include "file" line is replaced by the file,
+   which is looked for next to the file including it and then in the -I
+   directories. The included files are kept in memory (and reread if they
+   have changed), so a compiler that lives on, like the compile server,
+   only reads them once. Anything else, that is any other directive or a
+   -D or -U option, is left to cpp, run the way the diesel script runs it.
+   Can be used from several threads at once. */
+class preprocessor {
+private:
+    struct cached_file {
+        time_t modified;
+        string text;
+    };
+
+    // Files read so far, by path.
+    map<string, cached_file> files;
+
+    // Number of lines cpp prints before the program, found the first time
+    // cpp is run.
+    int cpp_header_lines;
+
+    mutex lock;
+
+    // Read a file, from the cache if it hasn't changed.
+    bool read_file(const string &, string &);
+
+    // Append the text of a file to the result, with its #include lines
+    // expanded. Arg 2 are the directories to look in. Returns false if the
+    // file needs cpp, or an included file wasn't found (which cpp reports).
+    bool expand(const string &, const vector<string> &, string &, int);
+
+    // Preprocess a file with cpp.
+    bool run_cpp(const string &, const vector<string> &, string &);
+
+public:
+    preprocessor();
+
+    //! Preprocess the file in arg 1. Arg 2 are the -I, -D and -U options
+    //! for cpp. The result is stored in arg 3. Prints an error and returns
+    //! false if a file couldn't be read.
+    bool preprocess(const string &, const vector<string> &, string &);
+};
+
+#endif
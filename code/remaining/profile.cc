@@ -0,0 +1,221 @@
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "profile.hh"
+
+using namespace std;
+
+thread_local compile_profile *profile = NULL;
+
+/* Allocations are counted by replacing the global operator new, but only
+   on a thread profiling a compilation. The array and nothrow forms call
+   this one. */
+static thread_local long allocation_count = 0;
+
+void *operator new(size_t size) {
+    if (profile != NULL) {
+        allocation_count++;
+    }
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+long allocations_made() {
+    return allocation_count;
+}
+
+static double milliseconds(clockid_t clock) {
+    struct timespec t;
+    clock_gettime(clock, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+double wall_time_ms() {
+    return milliseconds(CLOCK_MONOTONIC);
+}
+
+double cpu_time_ms() {
+    return milliseconds(CLOCK_THREAD_CPUTIME_ID);
+}
+
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static const char *PHASE_NAMES[NR_PHASES] = {
+    "scan",
+    "parse",
+    "typecheck",
+    "optimize",
+    "quads",
+    "quad_optimize",
+    "assembler",
+};
+
+compile_profile::measurement::measurement()
+    : wall_ms(0),
+      cpu_ms(0),
+      allocations(0),
+      rss_growth_kb(0) {
+}
+
+void compile_profile::measurement::add(const measurement &m) {
+    wall_ms += m.wall_ms;
+    cpu_ms += m.cpu_ms;
+    allocations += m.allocations;
+    rss_growth_kb += m.rss_growth_kb;
+}
+
+compile_profile::compile_profile()
+    : peak_rss(0) {
+}
+
+void compile_profile::add(compile_phase phase, symbol *block, double wall,
+                          double cpu, long allocations, long rss_growth) {
+    measurement m;
+    m.wall_ms = wall;
+    m.cpu_ms = cpu;
+    m.allocations = allocations;
+    m.rss_growth_kb = rss_growth;
+
+    totals[phase].add(m);
+    if (block == NULL) {
+        return;
+    }
+    if (per_block.find(block) == per_block.end()) {
+        blocks.push_back(block);
+        per_block[block].resize(NR_PHASES);
+    }
+    per_block[block][phase].add(m);
+
+    if (block->level == 0) {
+        program = sym_tab->pool_lookup(block->id);
+    }
+}
+
+void compile_profile::finish(double wall, double cpu, long allocations, long rss_growth) {
+    measurement &parse = totals[PHASE_PARSE];
+    parse.wall_ms = wall;
+    parse.cpu_ms = cpu;
+    parse.allocations = allocations;
+    parse.rss_growth_kb = rss_growth;
+    for (int i = 0; i < NR_PHASES; i++) {
+        if (i != PHASE_PARSE) {
+            parse.wall_ms -= totals[i].wall_ms;
+            parse.cpu_ms -= totals[i].cpu_ms;
+            parse.allocations -= totals[i].allocations;
+            parse.rss_growth_kb -= totals[i].rss_growth_kb;
+        }
+    }
+    peak_rss = peak_rss_kb();
+}
+
+void compile_profile::print(ostream &o) {
+    o << "\nCompile profile for " << program << endl;
+    o << setiosflags(ios::fixed) << setprecision(2);
+    o << "    " << left << setw(15) << "phase" << right << setw(10) << "wall ms"
+      << setw(10) << "cpu ms" << setw(12) << "allocs" << setw(14) << "RSS growth kB"
+      << endl;
+    measurement total;
+    for (int i = 0; i < NR_PHASES; i++) {
+        o << "    " << left << setw(15) << PHASE_NAMES[i] << right
+          << setw(10) << totals[i].wall_ms << setw(10) << totals[i].cpu_ms
+          << setw(12) << totals[i].allocations << setw(14) << totals[i].rss_growth_kb
+          << endl;
+        total.add(totals[i]);
+    }
+    o << "    " << left << setw(15) << "total" << right << setw(10) << total.wall_ms
+      << setw(10) << total.cpu_ms << setw(12) << total.allocations << setw(14)
+      << total.rss_growth_kb << endl;
+    o << "    " << left << setw(15) << "peak RSS kB" << right << setw(46) << peak_rss
+      << endl;
+
+    o << "\n    " << left << setw(15) << "block (wall ms)";
+    for (int i = PHASE_TYPECHECK; i < NR_PHASES; i++) {
+        o << right << setw(14) << PHASE_NAMES[i];
+    }
+    o << setw(12) << "allocs" << endl;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        vector<measurement> &phases = per_block[blocks[b]];
+        long allocations = 0;
+        o << "    " << left << setw(15) << sym_tab->pool_lookup(blocks[b]->id);
+        for (int i = PHASE_TYPECHECK; i < NR_PHASES; i++) {
+            o << right << setw(14) << phases[i].wall_ms;
+            allocations += phases[i].allocations;
+        }
+        o << setw(12) << allocations << endl;
+    }
+    o << resetiosflags(ios::fixed) << setprecision(6) << left;
+}
+
+/* Block names are Diesel identifiers, which need no escaping. */
+static void print_json_measurement(ostream &o, const char *name, double wall,
+                                   double cpu, long allocations, long rss_growth) {
+    o << "\"" << name << "\": {\"wall_ms\": " << wall << ", \"cpu_ms\": " << cpu
+      << ", \"allocations\": " << allocations << ", \"rss_growth_kb\": " << rss_growth
+      << "}";
+}
+
+void compile_profile::print_json(ostream &o) {
+    o << setiosflags(ios::fixed) << setprecision(3);
+    o << "{\n  \"program\": \"" << program << "\",\n  \"peak_rss_kb\": " << peak_rss
+      << ",\n  \"phases\": {";
+    for (int i = 0; i < NR_PHASES; i++) {
+        o << (i == 0 ? "\n    " : ",\n    ");
+        print_json_measurement(o, PHASE_NAMES[i], totals[i].wall_ms,
+                               totals[i].cpu_ms, totals[i].allocations,
+                               totals[i].rss_growth_kb);
+    }
+    o << "\n  },\n  \"blocks\": [";
+    for (size_t b = 0; b < blocks.size(); b++) {
+        vector<measurement> &phases = per_block[blocks[b]];
+        o << (b == 0 ? "\n    " : ",\n    ");
+        o << "{\"name\": \"" << sym_tab->pool_lookup(blocks[b]->id)
+          << "\", \"level\": " << blocks[b]->level << ", \"phases\": {";
+        for (int i = PHASE_TYPECHECK; i < NR_PHASES; i++) {
+            o << (i == PHASE_TYPECHECK ? "" : ", ");
+            print_json_measurement(o, PHASE_NAMES[i], phases[i].wall_ms,
+                                   phases[i].cpu_ms, phases[i].allocations,
+                                   phases[i].rss_growth_kb);
+        }
+        o << "}}";
+    }
+    o << "\n  ]\n}" << endl;
+    o << resetiosflags(ios::fixed) << setprecision(6);
+}
+
+phase_timer::phase_timer(compile_phase p, symbol *b)
+    : phase(p),
+      block(b) {
+    if (profile != NULL) {
+        wall_start = wall_time_ms();
+        cpu_start = cpu_time_ms();
+        allocations_start = allocations_made();
+        rss_start = peak_rss_kb();
+    }
+}
+
+phase_timer::~phase_timer() {
+    if (profile != NULL) {
+        profile->add(phase, block, wall_time_ms() - wall_start,
+                     cpu_time_ms() - cpu_start, allocations_made() - allocations_start,
+                     peak_rss_kb() - rss_start);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef __PROFILE_HH__
+#define __PROFILE_HH__
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "symtab.hh"
+
+using namespace std;
+
+/* The phases a compilation is timed in with -T. Scanning and parsing are
+   done for the whole program at once, the rest block by block. Parsing is
+   what remains of the compilation when the other phases, which run from
+   the parser's actions, are taken away. */
+enum compile_phase { PHASE_SCAN,
+                     PHASE_PARSE,
+                     PHASE_TYPECHECK,
+                     PHASE_OPTIMIZE,
+                     PHASE_QUADS,
+                     PHASE_QUAD_OPTIMIZE,
+                     PHASE_ASSEMBLER,
+                     NR_PHASES };
+
+/* Where the time and memory of a compilation went. Each phase gets its wall
+   time, the CPU time of the thread running it, the number of allocations
+   (calls to operator new) it made, and how much it raised the peak resident
+   set size of the process, in total and per block. The peak itself is
+   reported for the whole compilation. The resident set is the process's,
+   so in a compile server, compilations running at the same time share it. */
+class compile_profile {
+private:
+    struct measurement {
+        double wall_ms;
+        double cpu_ms;
+        long allocations;
+        long rss_growth_kb;
+
+        measurement();
+
+        void add(const measurement &);
+    };
+
+    // Totals per phase.
+    measurement totals[NR_PHASES];
+
+    // Per block, in the order the blocks were first seen.
+    vector<symbol *> blocks;
+    map<symbol *, vector<measurement> > per_block;
+
+    // The main program's name.
+    string program;
+
+    // The peak resident set size when the compilation was done.
+    long peak_rss;
+
+public:
+    compile_profile();
+
+    //! Add a measurement of a phase. Arg 2 = the block, or NULL for the
+    //! whole program, then wall ms, CPU ms, allocations and RSS growth in kB.
+    void add(compile_phase, symbol *, double, double, long, long);
+
+    //! Account the rest of a compilation that took arg 1 ms (wall) and arg
+    //! 2 ms (CPU) with arg 3 allocations, and raised the peak RSS by arg 4
+    //! kB, to parsing.
+    void finish(double, double, long, long);
+
+    //! A readable report.
+    void print(ostream &);
+
+    //! The same as JSON, for other programs to read.
+    void print_json(ostream &);
+};
+
+/* Measures a phase from construction to destruction if the compilation is
+   being profiled, and does nothing otherwise. */
+class phase_timer {
+private:
+    compile_phase phase;
+    symbol *block;
+    double wall_start;
+    double cpu_start;
+    long allocations_start;
+    long rss_start;
+
+public:
+    phase_timer(compile_phase, symbol *);
+    ~phase_timer();
+};
+
+//! Wall and thread CPU time in ms, from some fixed point.
+double wall_time_ms();
+double cpu_time_ms();
+
+//! The number of allocations made by the calling thread while it was
+//! profiling a compilation.
+long allocations_made();
+
+//! The peak resident set size of the process so far, in kB.
+long peak_rss_kb();
+
+// The profile of the compilation on this thread, or NULL if it isn't being
+// profiled. Set by compilation_context::activate().
+extern thread_local compile_profile *profile;
+
+#endif
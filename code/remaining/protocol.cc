@@ -0,0 +1,118 @@
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "protocol.hh"
+
+using namespace std;
+
+// Longest string we accept, to not be fooled into allocating too much.
+static const unsigned long MAX_LENGTH = 1UL << 30;
+
+/* Write all of a buffer, even if the socket takes it in pieces. */
+static bool write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* Numbers are sent as decimal text ending with a newline. */
+static bool write_number(int fd, long number) {
+    string text = to_string(number) + "\n";
+    return write_all(fd, text.data(), text.size());
+}
+
+static bool read_number(int fd, long &number) {
+    string text;
+    char c;
+    while (read_all(fd, &c, 1)) {
+        if (c == '\n') {
+            char *end;
+            number = strtol(text.c_str(), &end, 10);
+            return !text.empty() && *end == '\0';
+        }
+        if (text.size() > 20) {
+            return false;
+        }
+        text += c;
+    }
+    return false;
+}
+
+static bool write_string(int fd, const string &s) {
+    return write_number(fd, s.size()) && write_all(fd, s.data(), s.size());
+}
+
+static bool read_string(int fd, string &s) {
+    long size;
+    if (!read_number(fd, size) || size < 0 || (unsigned long)size > MAX_LENGTH) {
+        return false;
+    }
+    s.resize(size);
+    return size == 0 || read_all(fd, &s[0], size);
+}
+
+bool send_request(int fd, const vector<string> &args) {
+    if (!write_number(fd, args.size())) {
+        return false;
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        if (!write_string(fd, args[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool receive_request(int fd, vector<string> &args) {
+    long count;
+    if (!read_number(fd, count) || count < 0 || count > 1000) {
+        return false;
+    }
+    args.resize(count);
+    for (long i = 0; i < count; i++) {
+        if (!read_string(fd, args[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool send_reply(int fd, int status, const string &code,
+                const string &messages) {
+    return write_number(fd, status) && write_string(fd, code)
+           && write_string(fd, messages);
+}
+
+bool receive_reply(int fd, int &status, string &code, string &messages) {
+    long number;
+    if (!read_number(fd, number)) {
+        return false;
+    }
+    status = number;
+    return read_string(fd, code) && read_string(fd, messages);
+}
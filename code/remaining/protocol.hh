@@ -0,0 +1,25 @@
+#ifndef __PROTOCOL_HH__
+#define __PROTOCOL_HH__
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* The messages the compile server (server.hh) and its client (dieselc.cc)
+   send each other over the socket. A request is the argument list of a
+   compilation: the flags, as given to the compiler, and the source file
+   last. The reply is the exit status the compiler would have had, the
+   assembler code (including diesel_glue.s) and the error messages. All of
+   them are sent as a length followed by the bytes, so any text can be
+   sent. The functions return false if the connection was closed or broken. */
+
+bool send_request(int, const vector<string> &);
+
+bool receive_request(int, vector<string> &);
+
+bool send_reply(int, int, const string &, const string &);
+
+bool receive_reply(int, int &, string &, string &);
+
+#endif
@@ -0,0 +1,2105 @@
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "symtab.hh"
+#include "codegen.hh"
+#include "quadopt.hh"
+#include "codecache.hh"
+#include "context.hh"
+
+using namespace std;
+
+// Procedures with more quads than this (not counting labels) aren't inlined.
+static const int INLINE_SIZE_LIMIT = 12;
+
+// How many quads inlining may add to a single block.
+static const int INLINE_GROWTH_LIMIT = 120;
+
+// Inlining needs new temporaries, and stops before the symbol table fills
+// beyond this, leaving room for the rest of the program and the other
+// passes.
+static const int INLINE_SYMBOL_LIMIT = MAX_SYM * 3 / 4;
+
+// Used in parser.y. Run on every block unless the -f flag was given. Set by
+// compilation_context::activate().
+thread_local quad_optimizer *quad_opt = NULL;
+
+quad_optimizer::quad_optimizer()
+    : first_symbol(0),
+      symbol_room(0),
+      out_of_symbols(false) {
+}
+
+/* Runs the passes, and finally records what the block does to nonlocal
+   variables so later calls to it can be analysed precisely, and drops what
+   is no longer used from its activation record.
+
+   With a cache directory (the -C flag), the optimized quads are stored in
+   the cache, and a block that comes up again gets them from there instead
+   of running the passes, see codecache.hh. The cache isn't used with -i,
+   which prints what the inliner does, nor once the inliner has run out of
+   room in the symbol table. */
+void quad_optimizer::optimize(quad_list *q, sym_index env_p) {
+    symbol *env = sym_tab->get_symbol(env_p);
+    bool cached = !cache_directory.empty() && !print_inlining && !out_of_symbols;
+
+    vector<sym_index> symbols;
+    string key;
+    if (cached) {
+        symbols = quad_symbols(q);
+        key = optimizer_key(q, env, symbols, block_keys);
+        block_keys[env] = key;
+
+        string entry;
+        quad_list *optimized = NULL;
+        if (cache_lookup(cache_directory, key + ".q", entry)) {
+            optimized = read_optimized(entry, symbols, INLINE_SYMBOL_LIMIT, q->last_label);
+        }
+        if (optimized != NULL) {
+            control_flow_graph *cfg = new control_flow_graph(optimized, env);
+            cfg->write_back(q);
+            record_block(cfg, env_p);
+            delete cfg;
+            return;
+        }
+    }
+
+    first_symbol = sym_tab->get_symbol_count();
+    symbol_room = 0;
+    long first_label = sym_tab->get_label_count();
+    run_passes(q, env);
+
+    control_flow_graph *cfg = new control_flow_graph(q, env);
+    record_block(cfg, env_p);
+    delete cfg;
+
+    string entry;
+    if (cached && !out_of_symbols &&
+        write_optimized(q, symbols, first_symbol, first_label, symbol_room, entry)) {
+        cache_store(cache_directory, key + ".q", entry);
+    }
+}
+
+void quad_optimizer::run_passes(quad_list *q, symbol *env) {
+    // Inlining goes first, so the inlined code is optimized together with
+    // the code around it. Tail calls are next, since recursion turned into
+    // a loop can then be treated like any other loop.
+    control_flow_graph *cfg = new control_flow_graph(q, env);
+    inline_calls(cfg);
+    tail_calls(cfg);
+    cfg->write_back(q);
+    delete cfg;
+
+    // Constant propagation goes before value numbering, which then finds
+    // the loads of equal constants.
+    cfg = new control_flow_graph(q, env);
+    propagate_constants(cfg);
+    cfg->write_back(q);
+    delete cfg;
+
+    cfg = new control_flow_graph(q, env);
+    value_numbering(cfg);
+    cfg->write_back(q);
+    delete cfg;
+
+    transform_loops(q, env, &quad_optimizer::hoist_invariants);
+    transform_loops(q, env, &quad_optimizer::reduce_induction_variables);
+
+    // Hoisting brings equal quads from different loops together.
+    cfg = new control_flow_graph(q, env);
+    value_numbering(cfg);
+    cfg->write_back(q);
+    delete cfg;
+
+    // The passes above leave copies and temporaries nothing reads.
+    cfg = new control_flow_graph(q, env);
+    eliminate_dead_code(cfg);
+    cfg->write_back(q);
+    delete cfg;
+}
+
+void quad_optimizer::record_block(control_flow_graph *cfg, sym_index env_p) {
+    summaries->record(cfg);
+    record_inline_body(cfg);
+    compact_frame(cfg, env_p);
+}
+
+/* Sets operand number 'n' (as numbered by quad_operands) of a quad. Both the
+   sym and int fields are kept in step, see the quadruple constructor. */
+static void set_operand(quadruple *q, int n, sym_index sym_p) {
+    switch (q->op_code) {
+    case q_rstore:
+    case q_istore:
+        if (n == 0) {
+            q->sym1 = q->int1 = sym_p;
+        } else {
+            q->sym3 = q->int3 = sym_p;
+        }
+        break;
+    case q_rreturn:
+    case q_ireturn:
+    case q_jmpf:
+    case q_jmpt:
+        q->sym2 = q->int2 = sym_p;
+        break;
+    default:
+        if (n == 0) {
+            q->sym1 = q->int1 = sym_p;
+        } else {
+            q->sym2 = q->int2 = sym_p;
+        }
+    }
+}
+
+/* Replace the operands of a quad according to a renaming map. */
+static void rename_operands(quadruple *q, map<sym_index, sym_index> &renames) {
+    sym_index ops[3];
+    int n = quad_operands(q, ops);
+    for (int i = 0; i < n; i++) {
+        sym_index to = ops[i];
+        map<sym_index, sym_index>::iterator it = renames.find(to);
+        while (it != renames.end()) {
+            to = it->second;
+            it = renames.find(to);
+        }
+        if (to != ops[i]) {
+            set_operand(q, i, to);
+        }
+    }
+}
+
+/*****************************************************
+ *** SPARSE CONDITIONAL CONSTANT PROPAGATION ***
+ *****************************************************/
+
+/* What is known about the value of a variable at some point: nothing yet
+   (no definition of it has been found to be executed), a constant, or that
+   it may hold different values. Real constants are kept as the bit pattern
+   used by q_rload and the generated code. */
+enum lattice_state {
+    LATTICE_UNDEFINED,
+    LATTICE_CONSTANT,
+    LATTICE_VARYING
+};
+
+struct lattice_value {
+    lattice_state state;
+    long value;
+
+    lattice_value(lattice_state s = LATTICE_UNDEFINED, long v = 0)
+        : state(s)
+        , value(v) {
+    }
+
+    bool operator==(const lattice_value &other) const {
+        return state == other.state && value == other.value;
+    }
+    bool operator!=(const lattice_value &other) const {
+        return !(*this == other);
+    }
+};
+
+typedef vector<lattice_value> lattice_state_vector;
+
+static double real_of(long bits) {
+    double d;
+    memcpy(&d, &bits, sizeof(double));
+    return d;
+}
+
+static lattice_value meet(const lattice_value &a, const lattice_value &b) {
+    if (a.state == LATTICE_UNDEFINED) {
+        return b;
+    }
+    if (b.state == LATTICE_UNDEFINED) {
+        return a;
+    }
+    if (a == b) {
+        return a;
+    }
+    return lattice_value(LATTICE_VARYING);
+}
+
+/* Constant propagation over the control flow graph, in the style of Wegman
+   and Zadeck, but on the quads as they are rather than on SSA form: the
+   state of every tracked variable is kept at the start and end of each
+   block. Only edges found to be executable contribute to the state at the
+   start of a block, so a branch on a constant condition keeps the values
+   of the path not taken from spoiling the rest of the procedure, and the
+   blocks that are never reached can be removed. */
+class constant_propagator {
+private:
+    control_flow_graph *cfg;
+
+    vector<lattice_state_vector> in;
+    vector<lattice_state_vector> out;
+
+    vector<bool> executable;
+    set<pair<int, int> > executable_edges;
+
+    lattice_state_vector boundary();
+    lattice_value value_of(sym_index, lattice_state_vector &);
+    lattice_value evaluate(quadruple *, lattice_state_vector &);
+    void transfer(quadruple *, lattice_state_vector &);
+    void executable_successors(basic_block *, vector<basic_block *> &);
+    bool join(basic_block *);
+
+public:
+    constant_propagator(control_flow_graph *);
+
+    void solve();
+
+    // Rewrite the blocks. Returns true if anything changed.
+    bool rewrite();
+};
+
+constant_propagator::constant_propagator(control_flow_graph *g)
+    : cfg(g)
+    , in(g->blocks.size(), lattice_state_vector(g->variables.size()))
+    , out(g->blocks.size(), lattice_state_vector(g->variables.size()))
+    , executable(g->blocks.size(), false) {
+}
+
+/* Temporaries are always assigned before they are used. Anything else may
+   hold any value when the procedure is entered: parameters, nonlocals, and
+   local variables that are read before they are assigned. */
+lattice_state_vector constant_propagator::boundary() {
+    lattice_state_vector state(cfg->variables.size());
+    for (size_t i = 0; i < cfg->variables.size(); i++) {
+        if (!sym_tab->is_temp_var(cfg->variables[i])) {
+            state[i] = lattice_value(LATTICE_VARYING);
+        }
+    }
+    return state;
+}
+
+lattice_value constant_propagator::value_of(sym_index sym_p, lattice_state_vector &state) {
+    int nr = cfg->var_nr(sym_p);
+    if (nr >= 0) {
+        return state[nr];
+    }
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    if (sym->tag == SYM_CONST) {
+        constant_symbol *con = sym->get_constant_symbol();
+        if (sym->type == real_type) {
+            return lattice_value(LATTICE_CONSTANT, sym_tab->ieee(con->const_value.rval));
+        }
+        // The code generator loads integer constants as 32-bit values.
+        return lattice_value(LATTICE_CONSTANT, (int)con->const_value.ival);
+    }
+    return lattice_value(LATTICE_VARYING);
+}
+
+/* The value a quad computes, given the values of its operands. Division by
+   zero is left to happen at run time. */
+lattice_value constant_propagator::evaluate(quadruple *q, lattice_state_vector &state) {
+    switch (q->op_code) {
+    case q_iload:
+    case q_rload:
+        return lattice_value(LATTICE_CONSTANT, q->int1);
+    case q_iassign:
+    case q_rassign:
+        return value_of(q->sym1, state);
+    default:
+        break;
+    }
+
+    sym_index operands[3];
+    int n = quad_operands(q, operands);
+    if (n == 0 || n > 2 || !quad_is_pure(q) || quad_reads_memory(q) ||
+        q->op_code == q_lindex) {
+        return lattice_value(LATTICE_VARYING);
+    }
+
+    long a = 0, b = 0;
+    for (int i = 0; i < n; i++) {
+        lattice_value v = value_of(operands[i], state);
+        if (v.state != LATTICE_CONSTANT) {
+            return v;
+        }
+        (i == 0 ? a : b) = v.value;
+    }
+
+    // Integer arithmetic wraps around, like the generated code does.
+    unsigned long ua = a, ub = b;
+    double ra = real_of(a), rb = real_of(b);
+
+    switch (q->op_code) {
+    case q_itor:
+        return lattice_value(LATTICE_CONSTANT, sym_tab->ieee((double)a));
+    case q_inot:
+        return lattice_value(LATTICE_CONSTANT, a == 0);
+    case q_iuminus:
+        return lattice_value(LATTICE_CONSTANT, (long)(0 - ua));
+    case q_ruminus:
+        return lattice_value(LATTICE_CONSTANT, sym_tab->ieee(-ra));
+    case q_iplus:
+        return lattice_value(LATTICE_CONSTANT, (long)(ua + ub));
+    case q_iminus:
+        return lattice_value(LATTICE_CONSTANT, (long)(ua - ub));
+    case q_imult:
+        return lattice_value(LATTICE_CONSTANT, (long)(ua * ub));
+    case q_idivide:
+    case q_imod:
+        if (b == 0 || (b == -1 && a == LONG_MIN)) {
+            return lattice_value(LATTICE_VARYING);
+        }
+        return lattice_value(LATTICE_CONSTANT, q->op_code == q_idivide ? a / b : a % b);
+    case q_ior:
+        return lattice_value(LATTICE_CONSTANT, a != 0 || b != 0);
+    case q_iand:
+        return lattice_value(LATTICE_CONSTANT, a != 0 && b != 0);
+    case q_ieq:
+        return lattice_value(LATTICE_CONSTANT, a == b);
+    case q_ine:
+        return lattice_value(LATTICE_CONSTANT, a != b);
+    case q_ilt:
+        return lattice_value(LATTICE_CONSTANT, a < b);
+    case q_igt:
+        return lattice_value(LATTICE_CONSTANT, a > b);
+    case q_rplus:
+        return lattice_value(LATTICE_CONSTANT, sym_tab->ieee(ra + rb));
+    case q_rminus:
+        return lattice_value(LATTICE_CONSTANT, sym_tab->ieee(ra - rb));
+    case q_rmult:
+        return lattice_value(LATTICE_CONSTANT, sym_tab->ieee(ra * rb));
+    case q_rdivide:
+        if (rb == 0.0) {
+            return lattice_value(LATTICE_VARYING);
+        }
+        return lattice_value(LATTICE_CONSTANT, sym_tab->ieee(ra / rb));
+    case q_req:
+        return lattice_value(LATTICE_CONSTANT, ra == rb);
+    case q_rne:
+        return lattice_value(LATTICE_CONSTANT, ra != rb);
+    case q_rlt:
+        return lattice_value(LATTICE_CONSTANT, ra < rb);
+    case q_rgt:
+        return lattice_value(LATTICE_CONSTANT, ra > rb);
+    default:
+        return lattice_value(LATTICE_VARYING);
+    }
+}
+
+void constant_propagator::transfer(quadruple *q, lattice_state_vector &state) {
+    if (quad_is_call(q)) {
+        for (size_t i = 0; i < cfg->variables.size(); i++) {
+            if (cfg->call_may_access(q, cfg->variables[i])) {
+                state[i] = lattice_value(LATTICE_VARYING);
+            }
+        }
+    }
+
+    int nr = cfg->var_nr(quad_definition(q));
+    if (nr >= 0) {
+        state[nr] = evaluate(q, state);
+    }
+}
+
+/* The successors of a block that can be reached from it given what is known
+   at its end. A branch on a condition with no known value yet leads
+   nowhere, until the condition is found to be constant or varying. */
+void constant_propagator::executable_successors(basic_block *b, vector<basic_block *> &succs) {
+    quadruple *last = b->last_quad();
+    if (last != NULL && (last->op_code == q_jmpf || last->op_code == q_jmpt)) {
+        lattice_value cond = value_of(last->sym2, out[b->nr]);
+        if (cond.state == LATTICE_UNDEFINED) {
+            return;
+        }
+        if (cond.state == LATTICE_CONSTANT) {
+            bool taken = (last->op_code == q_jmpt) == (cond.value != 0);
+            if (taken) {
+                succs.push_back(cfg->block_for_label(last->int1));
+            } else {
+                succs.push_back(cfg->blocks[b->nr + 1]);
+            }
+            return;
+        }
+    }
+    succs = b->succs;
+}
+
+/* Recompute the state at the start of a block from its executable incoming
+   edges. Returns true if it changed. */
+bool constant_propagator::join(basic_block *b) {
+    lattice_state_vector state(cfg->variables.size());
+    if (b->nr == 0) {
+        state = boundary();
+    }
+    for (size_t i = 0; i < b->preds.size(); i++) {
+        basic_block *p = b->preds[i];
+        if (executable_edges.count(make_pair(p->nr, b->nr)) == 0) {
+            continue;
+        }
+        for (size_t j = 0; j < state.size(); j++) {
+            state[j] = meet(state[j], out[p->nr][j]);
+        }
+    }
+    if (state == in[b->nr]) {
+        return false;
+    }
+    in[b->nr] = state;
+    return true;
+}
+
+void constant_propagator::solve() {
+    vector<basic_block *> worklist;
+    vector<bool> listed(cfg->blocks.size(), false);
+
+    join(cfg->blocks[0]);
+    executable[0] = true;
+    worklist.push_back(cfg->blocks[0]);
+    listed[0] = true;
+
+    while (!worklist.empty()) {
+        basic_block *b = worklist.back();
+        worklist.pop_back();
+        listed[b->nr] = false;
+
+        lattice_state_vector state = in[b->nr];
+        for (size_t i = 0; i < b->quads.size(); i++) {
+            transfer(b->quads[i], state);
+        }
+        out[b->nr] = state;
+
+        vector<basic_block *> succs;
+        executable_successors(b, succs);
+        for (size_t i = 0; i < succs.size(); i++) {
+            basic_block *s = succs[i];
+            executable_edges.insert(make_pair(b->nr, s->nr));
+            if ((join(s) || !executable[s->nr]) && !listed[s->nr]) {
+                executable[s->nr] = true;
+                worklist.push_back(s);
+                listed[s->nr] = true;
+            }
+        }
+    }
+}
+
+/* Quads computing a constant become loads of it, branches on constants
+   become jumps or disappear, and the quads of blocks that are never reached
+   are removed. Their labels are left for later passes, so that jumps in
+   removed blocks don't have to be tracked down. */
+bool constant_propagator::rewrite() {
+    bool changed = false;
+
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        basic_block *b = cfg->blocks[i];
+        vector<quadruple *> quads;
+
+        if (!executable[i]) {
+            for (size_t j = 0; j < b->quads.size(); j++) {
+                if (b->quads[j]->op_code == q_labl) {
+                    quads.push_back(b->quads[j]);
+                } else {
+                    changed = true;
+                }
+            }
+            b->quads = quads;
+            continue;
+        }
+
+        lattice_state_vector state = in[i];
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            quadruple *q = b->quads[j];
+            sym_index def = quad_definition(q);
+
+            if (q->op_code == q_jmpf || q->op_code == q_jmpt) {
+                lattice_value cond = value_of(q->sym2, state);
+                if (cond.state == LATTICE_CONSTANT) {
+                    if ((q->op_code == q_jmpt) == (cond.value != 0)) {
+                        quads.push_back(new quadruple(q_jmp, q->int1, NULL_SYM, NULL_SYM));
+                    }
+                    changed = true;
+                    continue;
+                }
+            } else if (cfg->var_nr(def) >= 0 && q->op_code != q_iload &&
+                       q->op_code != q_rload && !quad_is_call(q)) {
+                lattice_value v = evaluate(q, state);
+                if (v.state == LATTICE_CONSTANT) {
+                    transfer(q, state);
+                    quad_op_type op =
+                        sym_tab->get_symbol_type(def) == real_type ? q_rload : q_iload;
+                    quads.push_back(new quadruple(op, v.value, NULL_SYM, def));
+                    changed = true;
+                    continue;
+                }
+            }
+
+            transfer(q, state);
+            quads.push_back(q);
+        }
+        b->quads = quads;
+    }
+    return changed;
+}
+
+void quad_optimizer::propagate_constants(control_flow_graph *cfg) {
+    constant_propagator propagator(cfg);
+    propagator.solve();
+    propagator.rewrite();
+}
+
+/*************************
+ *** VALUE NUMBERING ***
+ *************************/
+
+/* An expression that has been computed: the variable holding it and the
+   value number it had when the expression was computed. The entry is only
+   usable as long as the holder still has that value number. */
+struct vn_entry {
+    sym_index holder;
+    long vn;
+};
+
+typedef vector<long> vn_key;
+
+/* The state of value numbering one procedure. Within a basic block any
+   variable can be used; across blocks only temporaries that are assigned
+   exactly once are, since their value can't change on the way from the
+   defining block to the blocks it dominates. Such facts are kept in the
+   'stable' tables, which are scoped along the dominator tree. Array reads
+   are never reused after a store or a call that may write to an array,
+   which is what the memory epoch is for. */
+class value_numberer {
+private:
+    control_flow_graph *cfg;
+
+    // Number of quads assigning each variable.
+    map<sym_index, int> def_count;
+
+    // Temporaries that were replaced by an earlier holder of their value.
+    map<sym_index, sym_index> renames;
+
+    long next_vn;
+    long memory_epoch;
+
+    map<vn_key, long> constant_vns;
+
+    map<sym_index, long> stable_vns;
+    map<vn_key, vn_entry> stable_exprs;
+
+    map<sym_index, long> local_vns;
+    map<vn_key, vn_entry> local_exprs;
+
+    // Array reads in the current block, keyed on the address they read,
+    // so a later q_lindex of the same element can share the address.
+    map<vn_key, quadruple *> read_addresses;
+
+    // Array reads to split into a q_lindex and a fetch, with the temporary
+    // that will hold the address.
+    map<quadruple *, sym_index> splits;
+
+    vector<vector<basic_block *> > children;
+
+    bool is_stable(sym_index);
+    long vn_of(sym_index);
+    void set_vn(sym_index, long, vector<sym_index> &);
+    vn_key expression_key(quadruple *);
+    vn_key address_key(quadruple *);
+    bool lookup(const vn_key &, vn_entry &);
+    void forget_clobbered(quadruple *);
+    void replace(quadruple *, vn_entry &, vector<quadruple *> &);
+    void number_block(basic_block *);
+
+public:
+    value_numberer(control_flow_graph *);
+
+    void run();
+};
+
+value_numberer::value_numberer(control_flow_graph *g)
+    : cfg(g)
+    , next_vn(0)
+    , memory_epoch(0)
+    , children(g->blocks.size()) {
+    for (size_t i = 0; i < g->blocks.size(); i++) {
+        basic_block *b = g->blocks[i];
+        if (b->idom != NULL) {
+            children[b->idom->nr].push_back(b);
+        }
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            sym_index def = quad_definition(b->quads[j]);
+            if (def != NULL_SYM) {
+                def_count[def]++;
+            }
+        }
+    }
+}
+
+bool value_numberer::is_stable(sym_index sym_p) {
+    return sym_tab->is_temp_var(sym_p) && def_count[sym_p] == 1;
+}
+
+/* The value number of what a symbol holds right now. Constants are numbered
+   by their value, so two constants with equal values share a number. */
+long value_numberer::vn_of(sym_index sym_p) {
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    if (sym->tag == SYM_CONST) {
+        vn_key key;
+        key.push_back(sym->type);
+        if (sym->type == real_type) {
+            key.push_back(sym_tab->ieee(sym->get_constant_symbol()->const_value.rval));
+        } else {
+            key.push_back(sym->get_constant_symbol()->const_value.ival);
+        }
+        map<vn_key, long>::iterator it = constant_vns.find(key);
+        if (it != constant_vns.end()) {
+            return it->second;
+        }
+        constant_vns[key] = next_vn;
+        return next_vn++;
+    }
+
+    map<sym_index, long>::iterator it = stable_vns.find(sym_p);
+    if (it != stable_vns.end()) {
+        return it->second;
+    }
+    it = local_vns.find(sym_p);
+    if (it != local_vns.end()) {
+        return it->second;
+    }
+
+    // Nothing is known about the variable here, so it gets a value of its own.
+    local_vns[sym_p] = next_vn;
+    return next_vn++;
+}
+
+/* Record that a variable now holds a value. The names of stable variables
+   are logged so they can be forgotten when leaving the dominator subtree. */
+void value_numberer::set_vn(sym_index sym_p, long vn, vector<sym_index> &log) {
+    if (is_stable(sym_p)) {
+        stable_vns[sym_p] = vn;
+        log.push_back(sym_p);
+    } else {
+        local_vns[sym_p] = vn;
+    }
+}
+
+static bool is_commutative(quad_op_type op) {
+    switch (op) {
+    case q_rplus:
+    case q_iplus:
+    case q_ior:
+    case q_iand:
+    case q_rmult:
+    case q_imult:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* The key of the expression computed by a quad, or an empty key for quads
+   that don't compute reusable values. Array reads include the memory epoch
+   so they never match across a store. */
+vn_key value_numberer::expression_key(quadruple *q) {
+    vn_key key;
+    if (q->op_code == q_iassign || q->op_code == q_rassign ||
+        (!quad_is_pure(q) && !quad_reads_memory(q))) {
+        return key;
+    }
+
+    key.push_back(q->op_code);
+    if (q->op_code == q_iload || q->op_code == q_rload) {
+        key.push_back(q->int1);
+        return key;
+    }
+
+    sym_index ops[3];
+    int n = quad_operands(q, ops);
+    if (q->op_code == q_lindex || q->op_code == q_irindex || q->op_code == q_rrindex) {
+        // The array itself is identified by its symbol, not a value.
+        key.push_back(ops[0]);
+        key.push_back(vn_of(ops[1]));
+    } else {
+        for (int i = 0; i < n; i++) {
+            key.push_back(vn_of(ops[i]));
+        }
+        if (n == 2 && is_commutative(q->op_code) && key[1] > key[2]) {
+            swap(key[1], key[2]);
+        }
+    }
+    if (quad_reads_memory(q)) {
+        key.push_back(memory_epoch);
+    }
+    return key;
+}
+
+/* The key of the q_lindex computing the address an array read uses. */
+vn_key value_numberer::address_key(quadruple *q) {
+    vn_key key;
+    key.push_back(q_lindex);
+    key.push_back(q->sym1);
+    key.push_back(vn_of(q->sym2));
+    return key;
+}
+
+bool value_numberer::lookup(const vn_key &key, vn_entry &entry) {
+    map<vn_key, vn_entry>::iterator it = local_exprs.find(key);
+    if (it == local_exprs.end()) {
+        it = stable_exprs.find(key);
+        if (it == stable_exprs.end()) {
+            return false;
+        }
+    }
+    entry = it->second;
+    return vn_of(entry.holder) == entry.vn;
+}
+
+/* A call forgets the values of the variables it may change. */
+void value_numberer::forget_clobbered(quadruple *call) {
+    vector<sym_index> clobbered;
+    for (map<sym_index, long>::iterator it = local_vns.begin(); it != local_vns.end(); it++) {
+        if (cfg->call_may_access(call, it->first)) {
+            clobbered.push_back(it->first);
+        }
+    }
+    for (size_t i = 0; i < clobbered.size(); i++) {
+        local_vns.erase(clobbered[i]);
+    }
+    if (cfg->call_may_write_memory(call)) {
+        memory_epoch++;
+    }
+}
+
+/* The value computed by q is already held by entry.holder. A temporary that
+   is only assigned here is simply replaced by the holder everywhere; other
+   variables get a copy. */
+void value_numberer::replace(quadruple *q, vn_entry &entry, vector<quadruple *> &out) {
+    sym_index def = quad_definition(q);
+    if (is_stable(def)) {
+        renames[def] = entry.holder;
+        return;
+    }
+
+    quad_op_type copy = sym_tab->get_symbol_type(def) == real_type ? q_rassign : q_iassign;
+    out.push_back(new quadruple(copy, entry.holder, NULL_SYM, def));
+}
+
+void value_numberer::number_block(basic_block *b) {
+    vector<sym_index> vn_log;
+    vector<vn_key> expr_log;
+    vector<quadruple *> out;
+
+    local_vns.clear();
+    local_exprs.clear();
+    read_addresses.clear();
+    memory_epoch++;
+
+    for (size_t i = 0; i < b->quads.size(); i++) {
+        quadruple *q = b->quads[i];
+        rename_operands(q, renames);
+        sym_index def = quad_definition(q);
+
+        if (q->op_code == q_iassign || q->op_code == q_rassign) {
+            long vn = vn_of(q->sym1);
+            out.push_back(q);
+            set_vn(def, vn, vn_log);
+            continue;
+        }
+
+        vn_key key = expression_key(q);
+        if (key.empty()) {
+            out.push_back(q);
+            if (quad_is_call(q)) {
+                forget_clobbered(q);
+            } else if (quad_writes_memory(q)) {
+                memory_epoch++;
+            }
+            if (def != NULL_SYM) {
+                set_vn(def, next_vn++, vn_log);
+            }
+            continue;
+        }
+
+        vn_entry entry;
+        if (lookup(key, entry)) {
+            replace(q, entry, out);
+            set_vn(def, entry.vn, vn_log);
+            continue;
+        }
+
+        if (q->op_code == q_irindex || q->op_code == q_rrindex) {
+            // If the address of the element is around, just load from it.
+            vn_entry address;
+            if (lookup(address_key(q), address)) {
+                q->op_code = q->op_code == q_irindex ? q_ifetch : q_rfetch;
+                q->sym1 = q->int1 = address.holder;
+                q->sym2 = q->int2 = NULL_SYM;
+            } else {
+                read_addresses[address_key(q)] = q;
+            }
+        } else if (q->op_code == q_lindex && read_addresses.count(key)) {
+            // An earlier read of the same element computed this address
+            // without keeping it. Split that read into a q_lindex and a
+            // fetch, and let this quad use the address from there.
+            quadruple *read = read_addresses[key];
+            read_addresses.erase(key);
+            sym_index address = sym_tab->gen_temp_var(integer_type);
+            splits[read] = address;
+            vn_entry shared = { address, next_vn++ };
+            local_vns[address] = shared.vn;
+            local_exprs[key] = shared;
+            replace(q, shared, out);
+            set_vn(def, shared.vn, vn_log);
+            continue;
+        }
+
+        out.push_back(q);
+        long vn = next_vn++;
+        vn_entry fresh = { def, vn };
+        set_vn(def, vn, vn_log);
+
+        // Only expressions over stable values stay valid in dominated blocks.
+        bool stable = is_stable(def) && !quad_reads_memory(q);
+        sym_index ops[3];
+        int n = quad_operands(q, ops);
+        for (int j = 0; j < n && stable; j++) {
+            stable = is_stable(ops[j]) || sym_tab->get_symbol_tag(ops[j]) == SYM_CONST ||
+                     (j == 0 && q->op_code == q_lindex);
+        }
+        if (stable) {
+            stable_exprs[key] = fresh;
+            expr_log.push_back(key);
+        } else {
+            local_exprs[key] = fresh;
+        }
+    }
+
+    // Carry out the splits decided on above.
+    b->quads.clear();
+    for (size_t i = 0; i < out.size(); i++) {
+        quadruple *q = out[i];
+        map<quadruple *, sym_index>::iterator it = splits.find(q);
+        if (it == splits.end()) {
+            b->quads.push_back(q);
+            continue;
+        }
+        b->quads.push_back(new quadruple(q_lindex, q->sym1, q->sym2, it->second));
+        q->op_code = q->op_code == q_irindex ? q_ifetch : q_rfetch;
+        q->sym1 = q->int1 = it->second;
+        q->sym2 = q->int2 = NULL_SYM;
+        b->quads.push_back(q);
+    }
+
+    for (size_t i = 0; i < children[b->nr].size(); i++) {
+        number_block(children[b->nr][i]);
+    }
+
+    for (size_t i = 0; i < vn_log.size(); i++) {
+        stable_vns.erase(vn_log[i]);
+    }
+    for (size_t i = 0; i < expr_log.size(); i++) {
+        stable_exprs.erase(expr_log[i]);
+    }
+}
+
+void value_numberer::run() {
+    number_block(cfg->blocks[0]);
+
+    // Uses of renamed temporaries are normally in blocks dominated by their
+    // definition and have been renamed already, but make sure.
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        for (size_t j = 0; j < cfg->blocks[i]->quads.size(); j++) {
+            rename_operands(cfg->blocks[i]->quads[j], renames);
+        }
+    }
+}
+
+void quad_optimizer::value_numbering(control_flow_graph *cfg) {
+    value_numberer numberer(cfg);
+    numberer.run();
+}
+
+/************************************
+ *** LOOP-INVARIANT CODE MOTION ***
+ ************************************/
+
+/* Decides which quads in a loop compute the same value in every iteration.
+   Only quads assigning a temporary that is assigned nowhere else are moved,
+   since then the moved assignment still reaches every use of it. */
+class invariant_hoister {
+private:
+    control_flow_graph *cfg;
+    natural_loop *loop;
+
+    // Number of quads assigning each variable, in the procedure and in the loop.
+    map<sym_index, int> def_count;
+    map<sym_index, int> loop_def_count;
+
+    vector<quadruple *> calls;
+
+    // True if something in the loop may store into an array.
+    bool writes_memory;
+
+    // The blocks leaving the loop.
+    vector<basic_block *> exits;
+
+    bool dominates_exits(basic_block *);
+
+public:
+    invariant_hoister(control_flow_graph *, natural_loop *);
+
+    // Number of quads assigning a variable, in the procedure and in the loop.
+    int defs(sym_index sym_p) {
+        return def_count[sym_p];
+    }
+    int loop_defs(sym_index sym_p) {
+        return loop_def_count[sym_p];
+    }
+
+    // True if a call in the loop may read or write the variable.
+    bool touched_by_calls(sym_index);
+
+    bool is_invariant(sym_index);
+    bool can_hoist(quadruple *, basic_block *);
+    void hoisted(quadruple *);
+};
+
+invariant_hoister::invariant_hoister(control_flow_graph *g, natural_loop *l)
+    : cfg(g)
+    , loop(l)
+    , writes_memory(false) {
+    for (size_t i = 0; i < g->blocks.size(); i++) {
+        basic_block *b = g->blocks[i];
+        bool in_loop = l->contains[b->nr];
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            quadruple *q = b->quads[j];
+            sym_index def = quad_definition(q);
+            if (def != NULL_SYM) {
+                def_count[def]++;
+                if (in_loop) {
+                    loop_def_count[def]++;
+                }
+            }
+            if (!in_loop) {
+                continue;
+            }
+            if (quad_is_call(q)) {
+                calls.push_back(q);
+                writes_memory |= g->call_may_write_memory(q);
+            }
+            writes_memory |= quad_writes_memory(q);
+        }
+        if (!in_loop) {
+            continue;
+        }
+        for (size_t j = 0; j < b->succs.size(); j++) {
+            if (!l->contains[b->succs[j]->nr]) {
+                exits.push_back(b);
+                break;
+            }
+        }
+    }
+}
+
+/* True if every path leaving the loop passes through the block, ie, the
+   block is executed whenever the loop is entered. */
+bool invariant_hoister::dominates_exits(basic_block *b) {
+    for (size_t i = 0; i < exits.size(); i++) {
+        if (!cfg->dominates(b, exits[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool invariant_hoister::touched_by_calls(sym_index sym_p) {
+    for (size_t i = 0; i < calls.size(); i++) {
+        if (cfg->call_may_access(calls[i], sym_p)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* True if a symbol holds the same value throughout the loop. */
+bool invariant_hoister::is_invariant(sym_index sym_p) {
+    if (sym_tab->get_symbol_tag(sym_p) == SYM_CONST) {
+        return true;
+    }
+    return loop_def_count[sym_p] == 0 && !touched_by_calls(sym_p);
+}
+
+bool invariant_hoister::can_hoist(quadruple *q, basic_block *b) {
+    sym_index def = quad_definition(q);
+    if (def == NULL_SYM || !sym_tab->is_temp_var(def) || def_count[def] != 1) {
+        return false;
+    }
+
+    bool reads_memory = quad_reads_memory(q);
+    if (!quad_is_pure(q) && !reads_memory) {
+        return false;
+    }
+
+    sym_index ops[3];
+    int n = quad_operands(q, ops);
+    for (int i = 0; i < n; i++) {
+        // The address of an array never changes, only its contents.
+        if (i == 0 && (q->op_code == q_lindex || q->op_code == q_irindex ||
+                       q->op_code == q_rrindex)) {
+            continue;
+        }
+        if (!is_invariant(ops[i])) {
+            return false;
+        }
+    }
+
+    // Quads that may trap can't be executed when the loop wouldn't have.
+    if (reads_memory) {
+        return !writes_memory && dominates_exits(b);
+    }
+    if (q->op_code == q_idivide || q->op_code == q_imod) {
+        return dominates_exits(b);
+    }
+    return true;
+}
+
+void invariant_hoister::hoisted(quadruple *q) {
+    loop_def_count[quad_definition(q)]--;
+}
+
+/* Apply a transformation to every loop with a labelled header, innermost
+   loops first. The graph is rebuilt after each loop, since the loop's
+   preheader becomes part of the enclosing loop. */
+void quad_optimizer::transform_loops(quad_list *q, symbol *env, loop_transformation transform) {
+    // Header labels of the loops already handled.
+    set<int> done;
+
+    while (true) {
+        control_flow_graph *cfg = new control_flow_graph(q, env);
+        natural_loop *innermost = NULL;
+        for (size_t i = 0; i < cfg->loops.size(); i++) {
+            natural_loop *loop = cfg->loops[i];
+            if (loop->header->label < 0 || done.count(loop->header->label)) {
+                continue;
+            }
+            if (innermost == NULL || loop->depth > innermost->depth) {
+                innermost = loop;
+            }
+        }
+        if (innermost == NULL) {
+            delete cfg;
+            return;
+        }
+
+        done.insert(innermost->header->label);
+        if ((this->*transform)(cfg, innermost)) {
+            cfg->write_back(q);
+        }
+        delete cfg;
+    }
+}
+
+/* A preheader goes right before the loop header, which doesn't work if the
+   loop itself falls through into the header there. */
+static bool can_add_preheader(control_flow_graph *cfg, natural_loop *loop) {
+    basic_block *header = loop->header;
+    if (header->nr == 0) {
+        return true;
+    }
+    basic_block *prev = cfg->blocks[header->nr - 1];
+    quadruple *last = prev->last_quad();
+    return !loop->contains[prev->nr] ||
+           (last != NULL && last->op_code != q_jmpf && last->op_code != q_jmpt &&
+            quad_is_jump(last));
+}
+
+/* Put a block with the given quads in front of the loop, and let the jumps
+   entering the loop go there. */
+static void add_preheader(control_flow_graph *cfg, natural_loop *loop,
+                          vector<quadruple *> &quads) {
+    basic_block *header = loop->header;
+    basic_block *preheader = new basic_block(cfg->blocks.size());
+    preheader->label = sym_tab->get_next_label();
+    preheader->quads.push_back(new quadruple(q_labl, preheader->label, NULL_SYM, NULL_SYM));
+    preheader->quads.insert(preheader->quads.end(), quads.begin(), quads.end());
+
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        basic_block *b = cfg->blocks[i];
+        quadruple *last = b->last_quad();
+        if (loop->contains[b->nr] || last == NULL || !quad_is_jump(last) ||
+            quad_jump_target(last) != header->label) {
+            continue;
+        }
+        last->sym1 = last->int1 = preheader->label;
+    }
+    cfg->blocks.insert(cfg->blocks.begin() + header->nr, preheader);
+}
+
+bool quad_optimizer::hoist_invariants(control_flow_graph *cfg, natural_loop *loop) {
+    if (!can_add_preheader(cfg, loop)) {
+        return false;
+    }
+
+    invariant_hoister hoister(cfg, loop);
+    vector<quadruple *> hoisted;
+
+    // Hoisting a quad can make quads using its result invariant, so repeat
+    // until nothing more moves. Blocks are visited in reverse postorder so
+    // quads are hoisted after the quads they depend on.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < cfg->rpo.size(); i++) {
+            basic_block *b = cfg->rpo[i];
+            if (!loop->contains[b->nr]) {
+                continue;
+            }
+            vector<quadruple *> kept;
+            for (size_t j = 0; j < b->quads.size(); j++) {
+                quadruple *q = b->quads[j];
+                if (hoister.can_hoist(q, b)) {
+                    hoisted.push_back(q);
+                    hoister.hoisted(q);
+                    changed = true;
+                } else {
+                    kept.push_back(q);
+                }
+            }
+            b->quads = kept;
+        }
+    }
+
+    // Variables of enclosing blocks are reached through the display on
+    // every access. If the loop only reads one, read it once into a
+    // temporary before the loop instead.
+    map<sym_index, sym_index> promoted;
+    for (size_t i = 0; i < loop->blocks.size(); i++) {
+        basic_block *b = loop->blocks[i];
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            quadruple *q = b->quads[j];
+            sym_index ops[3];
+            int n = quad_operands(q, ops);
+            for (int k = 0; k < n; k++) {
+                sym_type tag = sym_tab->get_symbol_tag(ops[k]);
+                if ((tag != SYM_VAR && tag != SYM_PARAM) || cfg->is_local(ops[k]) ||
+                    sym_tab->is_temp_var(ops[k]) || !hoister.is_invariant(ops[k])) {
+                    continue;
+                }
+                if (!promoted.count(ops[k])) {
+                    sym_index type = sym_tab->get_symbol_type(ops[k]);
+                    sym_index temp = sym_tab->gen_temp_var(type);
+                    quad_op_type copy = type == real_type ? q_rassign : q_iassign;
+                    hoisted.push_back(new quadruple(copy, ops[k], NULL_SYM, temp));
+                    promoted[ops[k]] = temp;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < loop->blocks.size(); i++) {
+        basic_block *b = loop->blocks[i];
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            rename_operands(b->quads[j], promoted);
+        }
+    }
+
+    if (hoisted.empty()) {
+        return false;
+    }
+
+    add_preheader(cfg, loop, hoisted);
+    return true;
+}
+
+/*****************************************
+ *** INDUCTION VARIABLE STRENGTH REDUCTION ***
+ *****************************************/
+
+/* An update of a basic induction variable: t := k + step (or k - step)
+   followed by k := t, in the same block. */
+struct iv_update {
+    quadruple *step_quad;
+    quadruple *assign;
+    sym_index step;
+    bool down;
+};
+
+/* A basic induction variable of a loop: a variable that is only changed in
+   the loop by adding or subtracting loop-invariant amounts. */
+struct induction_variable {
+    sym_index var;
+    vector<iv_update> updates;
+};
+
+/* Number of quads in a block list reading a symbol. */
+static int count_uses(vector<basic_block *> &blocks, sym_index sym_p) {
+    int uses = 0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        for (size_t j = 0; j < blocks[i]->quads.size(); j++) {
+            sym_index ops[3];
+            int n = quad_operands(blocks[i]->quads[j], ops);
+            for (int k = 0; k < n; k++) {
+                if (ops[k] == sym_p) {
+                    uses++;
+                }
+            }
+        }
+    }
+    return uses;
+}
+
+static bool is_index_quad(quadruple *q, sym_index index) {
+    return (q->op_code == q_lindex || q->op_code == q_irindex || q->op_code == q_rrindex) &&
+           q->sym2 == index;
+}
+
+/* Find the basic induction variables of a loop. */
+static vector<induction_variable> find_induction_variables(natural_loop *loop,
+                                                           invariant_hoister &hoister) {
+    map<sym_index, induction_variable> found;
+    set<sym_index> rejected;
+
+    for (size_t i = 0; i < loop->blocks.size(); i++) {
+        basic_block *b = loop->blocks[i];
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            quadruple *q = b->quads[j];
+            sym_index var = q->sym3;
+            if (q->op_code != q_iassign || sym_tab->is_temp_var(var) ||
+                (sym_tab->get_symbol_tag(var) != SYM_VAR &&
+                 sym_tab->get_symbol_tag(var) != SYM_PARAM)) {
+                continue;
+            }
+
+            // Look for the quad computing the new value, making sure the
+            // variable isn't changed in between.
+            iv_update update = { NULL, q, NULL_SYM, false };
+            for (size_t k = j; k-- > 0;) {
+                quadruple *prev = b->quads[k];
+                if (quad_definition(prev) == var) {
+                    break;
+                }
+                if (quad_definition(prev) != q->sym1) {
+                    continue;
+                }
+                if (prev->op_code == q_iplus && prev->sym1 == var) {
+                    update.step = prev->sym2;
+                } else if (prev->op_code == q_iplus && prev->sym2 == var) {
+                    update.step = prev->sym1;
+                } else if (prev->op_code == q_iminus && prev->sym1 == var) {
+                    update.step = prev->sym2;
+                    update.down = true;
+                }
+                update.step_quad = prev;
+                break;
+            }
+
+            if (update.step == NULL_SYM || update.step == var ||
+                !sym_tab->is_temp_var(q->sym1) || hoister.defs(q->sym1) != 1 ||
+                !hoister.is_invariant(update.step)) {
+                rejected.insert(var);
+                continue;
+            }
+            found[var].var = var;
+            found[var].updates.push_back(update);
+        }
+    }
+
+    vector<induction_variable> result;
+    for (map<sym_index, induction_variable>::iterator it = found.begin(); it != found.end();
+         it++) {
+        if (!rejected.count(it->first) &&
+            hoister.loop_defs(it->first) == (int)it->second.updates.size() &&
+            !hoister.touched_by_calls(it->first)) {
+            result.push_back(it->second);
+        }
+    }
+    return result;
+}
+
+/* Replaces the array accesses indexed directly by an induction variable k
+   with accesses through a pointer per array, kept equal to the address of
+   element k by subtracting (elements are stored downwards) the step times
+   the element size whenever k is updated. When k is then only used to
+   test for the end of the loop, and isn't needed after the loop, the test
+   is made on the pointer instead and k is no longer updated at all. */
+bool quad_optimizer::reduce_induction_variables(control_flow_graph *cfg, natural_loop *loop) {
+    if (!can_add_preheader(cfg, loop)) {
+        return false;
+    }
+
+    invariant_hoister hoister(cfg, loop);
+    vector<induction_variable> ivs = find_induction_variables(loop, hoister);
+    if (ivs.empty()) {
+        return false;
+    }
+
+    liveness_analysis liveness(cfg);
+    vector<quadruple *> preheader;
+
+    for (size_t v = 0; v < ivs.size(); v++) {
+        induction_variable &iv = ivs[v];
+        sym_index k = iv.var;
+
+        // One pointer per array indexed by k, starting at element k.
+        vector<sym_index> arrays;
+        map<sym_index, sym_index> pointers;
+        for (size_t i = 0; i < loop->blocks.size(); i++) {
+            basic_block *b = loop->blocks[i];
+            for (size_t j = 0; j < b->quads.size(); j++) {
+                quadruple *q = b->quads[j];
+                if (is_index_quad(q, k) && !pointers.count(q->sym1)) {
+                    sym_index pointer = sym_tab->gen_temp_var(integer_type);
+                    preheader.push_back(new quadruple(q_lindex, q->sym1, k, pointer));
+                    arrays.push_back(q->sym1);
+                    pointers[q->sym1] = pointer;
+                }
+            }
+        }
+        if (arrays.empty()) {
+            continue;
+        }
+
+        // How much the pointers move at each update.
+        map<quadruple *, sym_index> strides;
+        for (size_t i = 0; i < iv.updates.size(); i++) {
+            sym_index step = iv.updates[i].step;
+            sym_index stride = sym_tab->gen_temp_var(integer_type);
+            if (sym_tab->get_symbol_tag(step) == SYM_CONST) {
+                long value = sym_tab->get_symbol(step)->get_constant_symbol()->const_value.ival;
+                preheader.push_back(
+                    new quadruple(q_iload, value * STACK_WIDTH, NULL_SYM, stride));
+            } else {
+                sym_index width = sym_tab->gen_temp_var(integer_type);
+                preheader.push_back(new quadruple(q_iload, STACK_WIDTH, NULL_SYM, width));
+                preheader.push_back(new quadruple(q_imult, step, width, stride));
+            }
+            strides[iv.updates[i].assign] = stride;
+        }
+        map<quadruple *, bool> down;
+        for (size_t i = 0; i < iv.updates.size(); i++) {
+            down[iv.updates[i].assign] = iv.updates[i].down;
+        }
+
+        map<sym_index, sym_index> renames;
+        for (size_t i = 0; i < loop->blocks.size(); i++) {
+            basic_block *b = loop->blocks[i];
+            vector<quadruple *> rewritten;
+            for (size_t j = 0; j < b->quads.size(); j++) {
+                quadruple *q = b->quads[j];
+                if (is_index_quad(q, k)) {
+                    sym_index pointer = pointers[q->sym1];
+                    if (q->op_code != q_lindex) {
+                        q->op_code = q->op_code == q_irindex ? q_ifetch : q_rfetch;
+                        q->sym1 = q->int1 = pointer;
+                        q->sym2 = q->int2 = NULL_SYM;
+                    } else {
+                        // The address can be used straight from the pointer
+                        // if it is only used before k next changes.
+                        sym_index address = q->sym3;
+                        int uses = 0;
+                        for (size_t l = j + 1; l < b->quads.size(); l++) {
+                            if (strides.count(b->quads[l])) {
+                                break;
+                            }
+                            sym_index ops[3];
+                            int n = quad_operands(b->quads[l], ops);
+                            for (int m = 0; m < n; m++) {
+                                uses += ops[m] == address;
+                            }
+                        }
+                        if (hoister.defs(address) == 1 && sym_tab->is_temp_var(address) &&
+                            uses == count_uses(cfg->blocks, address)) {
+                            renames[address] = pointer;
+                            continue;
+                        }
+                        q->op_code = q_iassign;
+                        q->sym1 = q->int1 = pointer;
+                        q->sym2 = q->int2 = NULL_SYM;
+                    }
+                }
+                rewritten.push_back(q);
+
+                if (strides.count(q)) {
+                    quad_op_type op = down[q] ? q_iplus : q_iminus;
+                    for (size_t a = 0; a < arrays.size(); a++) {
+                        sym_index pointer = pointers[arrays[a]];
+                        rewritten.push_back(new quadruple(op, pointer, strides[q], pointer));
+                    }
+                }
+            }
+            b->quads = rewritten;
+        }
+        for (size_t i = 0; i < loop->blocks.size(); i++) {
+            basic_block *b = loop->blocks[i];
+            for (size_t j = 0; j < b->quads.size(); j++) {
+                rename_operands(b->quads[j], renames);
+            }
+        }
+
+        // Try to get rid of k. It must be dead when leaving the loop...
+        int nr = cfg->var_nr(k);
+        bool removable = cfg->is_local(k) && nr >= 0;
+        for (size_t i = 0; i < loop->blocks.size() && removable; i++) {
+            basic_block *b = loop->blocks[i];
+            for (size_t j = 0; j < b->succs.size(); j++) {
+                if (!loop->contains[b->succs[j]->nr] && liveness.in[b->succs[j]->nr].test(nr)) {
+                    removable = false;
+                }
+            }
+        }
+        // ...and only be used by its updates and by comparisons with
+        // invariants. The new values must only be used for updating k.
+        set<quadruple *> step_quads;
+        for (size_t i = 0; i < iv.updates.size() && removable; i++) {
+            step_quads.insert(iv.updates[i].step_quad);
+            removable = count_uses(cfg->blocks, iv.updates[i].assign->sym1) == 1;
+        }
+        vector<quadruple *> tests;
+        for (size_t i = 0; i < loop->blocks.size() && removable; i++) {
+            basic_block *b = loop->blocks[i];
+            for (size_t j = 0; j < b->quads.size() && removable; j++) {
+                quadruple *q = b->quads[j];
+                sym_index ops[3];
+                int n = quad_operands(q, ops);
+                if (step_quads.count(q) || find(ops, ops + n, k) == ops + n) {
+                    continue;
+                }
+                sym_index other = q->sym1 == k ? q->sym2 : q->sym1;
+                removable = (q->op_code == q_ilt || q->op_code == q_igt ||
+                             q->op_code == q_ieq || q->op_code == q_ine) &&
+                            other != k && hoister.is_invariant(other);
+                tests.push_back(q);
+            }
+        }
+        if (!removable) {
+            continue;
+        }
+
+        // Compare the first pointer with the address of the element the
+        // bound indexes instead. Since addresses go down as indices go up,
+        // < and > swap places.
+        sym_index array = arrays[0];
+        map<sym_index, sym_index> bounds;
+        for (size_t i = 0; i < tests.size(); i++) {
+            quadruple *q = tests[i];
+            sym_index other = q->sym1 == k ? q->sym2 : q->sym1;
+            if (!bounds.count(other)) {
+                bounds[other] = sym_tab->gen_temp_var(integer_type);
+                preheader.push_back(new quadruple(q_lindex, array, other, bounds[other]));
+            }
+            map<sym_index, sym_index> replaced;
+            replaced[k] = pointers[array];
+            replaced[other] = bounds[other];
+            rename_operands(q, replaced);
+            if (q->op_code == q_ilt) {
+                q->op_code = q_igt;
+            } else if (q->op_code == q_igt) {
+                q->op_code = q_ilt;
+            }
+        }
+        for (size_t i = 0; i < loop->blocks.size(); i++) {
+            basic_block *b = loop->blocks[i];
+            vector<quadruple *> kept;
+            for (size_t j = 0; j < b->quads.size(); j++) {
+                quadruple *q = b->quads[j];
+                if (!step_quads.count(q) && !strides.count(q)) {
+                    kept.push_back(q);
+                }
+            }
+            b->quads = kept;
+        }
+    }
+
+    if (preheader.empty()) {
+        return false;
+    }
+    add_preheader(cfg, loop, preheader);
+    return true;
+}
+
+/******************************
+ *** DEAD CODE ELIMINATION ***
+ ******************************/
+
+/* True if a quad may be removed when what it assigns is never read. */
+static bool is_removable(quadruple *q) {
+    return quad_is_pure(q) || quad_reads_memory(q);
+}
+
+/* True if the label is the next thing executed after the end of block nr,
+   ie, if only labels come in between. */
+static bool label_follows(control_flow_graph *cfg, size_t nr, long label) {
+    for (size_t i = nr + 1; i < cfg->blocks.size(); i++) {
+        vector<quadruple *> &quads = cfg->blocks[i]->quads;
+        for (size_t j = 0; j < quads.size(); j++) {
+            if (quads[j]->op_code != q_labl) {
+                return false;
+            }
+            if (quads[j]->int1 == label) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* Removes quads assigning a variable that isn't live afterwards, which also
+   takes care of stores that are overwritten before being read. Removing a
+   quad can make the quads computing its operands dead in turn, so this is
+   repeated until nothing more is found. Blocks that can't be reached lose
+   all their quads, and afterwards jumps to the quad following them and
+   labels that nothing jumps to are removed, letting the blocks around them
+   merge when the graph is built again. */
+void quad_optimizer::eliminate_dead_code(control_flow_graph *cfg) {
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        basic_block *b = cfg->blocks[i];
+        if (b->rpo_nr < 0) {
+            vector<quadruple *> labels;
+            for (size_t j = 0; j < b->quads.size(); j++) {
+                if (b->quads[j]->op_code == q_labl) {
+                    labels.push_back(b->quads[j]);
+                }
+            }
+            b->quads = labels;
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        liveness_analysis live(cfg);
+        live.solve();
+
+        for (size_t i = 0; i < cfg->blocks.size(); i++) {
+            basic_block *b = cfg->blocks[i];
+            bit_vector set = live.out[i];
+            vector<quadruple *> kept;
+
+            for (size_t j = b->quads.size(); j-- > 0;) {
+                quadruple *q = b->quads[j];
+                int def = cfg->var_nr(quad_definition(q));
+                if (def >= 0 && !set.test(def) && is_removable(q)) {
+                    changed = true;
+                    continue;
+                }
+                live.transfer(q, set);
+                kept.push_back(q);
+            }
+            reverse(kept.begin(), kept.end());
+            b->quads = kept;
+        }
+    }
+
+    set<long> targets;
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        basic_block *b = cfg->blocks[i];
+        quadruple *last = b->last_quad();
+        if (last != NULL &&
+            (last->op_code == q_jmp || last->op_code == q_jmpf || last->op_code == q_jmpt) &&
+            label_follows(cfg, i, last->int1)) {
+            b->quads.pop_back();
+            last = b->last_quad();
+        }
+        if (last != NULL && quad_is_jump(last)) {
+            targets.insert(quad_jump_target(last));
+        }
+    }
+
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        basic_block *b = cfg->blocks[i];
+        vector<quadruple *> kept;
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            quadruple *q = b->quads[j];
+            if (q->op_code == q_labl && q->int1 != cfg->last_label &&
+                targets.find(q->int1) == targets.end()) {
+                continue;
+            }
+            kept.push_back(q);
+        }
+        b->quads = kept;
+    }
+}
+
+/* Gives the variables and temporaries of the block that are still used
+   after optimization new, packed, offsets in the activation record, and
+   shrinks it accordingly. Procedures nested in the block have already been
+   compiled using the offsets of the variables they access, so those keep
+   their places and the others are fitted around them. */
+void quad_optimizer::compact_frame(control_flow_graph *cfg, sym_index env_p) {
+    symbol *env = cfg->env;
+    int *ar_size;
+    if (env->tag == SYM_PROC) {
+        ar_size = &env->get_procedure_symbol()->ar_size;
+    } else if (env->tag == SYM_FUNC) {
+        ar_size = &env->get_function_symbol()->ar_size;
+    } else {
+        return;
+    }
+
+    set<sym_index> used;
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        for (size_t j = 0; j < cfg->blocks[i]->quads.size(); j++) {
+            quadruple *q = cfg->blocks[i]->quads[j];
+            sym_index syms[4];
+            int n = quad_operands(q, syms);
+            syms[n++] = quad_definition(q);
+            for (int k = 0; k < n; k++) {
+                used.insert(syms[k]);
+            }
+        }
+    }
+
+    // The block's own variables and arrays come after it in the table, and
+    // the procedures nested in it too.
+    sym_index count = sym_tab->get_symbol_count();
+    vector<sym_index> locals;
+    vector<symbol *> nested;
+    for (sym_index i = env_p + 1; i < count; i++) {
+        symbol *sym = sym_tab->get_symbol(i);
+        if (sym->level <= env->level) {
+            continue;
+        }
+        if (sym->tag == SYM_PROC || sym->tag == SYM_FUNC) {
+            nested.push_back(sym);
+        } else if ((sym->tag == SYM_VAR || sym->tag == SYM_ARRAY) &&
+                   sym->level == env->level + 1) {
+            locals.push_back(i);
+        }
+    }
+
+    // Intervals of the activation record taken by the pinned locals.
+    vector<pair<int, int> > taken;
+    vector<sym_index> moving;
+    for (size_t i = 0; i < locals.size(); i++) {
+        symbol *sym = sym_tab->get_symbol(locals[i]);
+        int size = sym_tab->get_size(sym->type);
+        if (sym->tag == SYM_ARRAY) {
+            size *= sym->get_array_symbol()->array_cardinality;
+        }
+
+        bool pinned = false;
+        for (size_t j = 0; j < nested.size(); j++) {
+            if (summaries->may_access(nested[j], locals[i])) {
+                pinned = true;
+            }
+        }
+        if (pinned) {
+            taken.push_back(make_pair(sym->offset, sym->offset + size));
+        } else if (used.find(locals[i]) != used.end()) {
+            moving.push_back(locals[i]);
+        }
+    }
+
+    // The free gaps between them, in order, the last one without an end.
+    // Each moving local goes at the start of the first gap it fits in.
+    sort(taken.begin(), taken.end());
+    vector<pair<int, int> > gaps;
+    int end = 0;
+    for (size_t i = 0; i < taken.size(); i++) {
+        if (taken[i].first > end) {
+            gaps.push_back(make_pair(end, taken[i].first));
+        }
+        end = max(end, taken[i].second);
+    }
+    gaps.push_back(make_pair(end, INT_MAX));
+
+    int size = end;
+    map<sym_index, int> offsets;
+    for (size_t i = 0; i < moving.size(); i++) {
+        symbol *sym = sym_tab->get_symbol(moving[i]);
+        int local_size = sym_tab->get_size(sym->type);
+        if (sym->tag == SYM_ARRAY) {
+            local_size *= sym->get_array_symbol()->array_cardinality;
+        }
+
+        size_t gap = 0;
+        while (gaps[gap].second - gaps[gap].first < local_size) {
+            gap++;
+        }
+        offsets[moving[i]] = gaps[gap].first;
+        gaps[gap].first += local_size;
+        size = max(size, gaps[gap].first);
+    }
+    if (size >= *ar_size) {
+        return;
+    }
+    for (map<sym_index, int>::iterator it = offsets.begin(); it != offsets.end(); it++) {
+        sym_tab->get_symbol(it->first)->offset = it->second;
+    }
+    *ar_size = size;
+}
+
+/******************
+ *** TAIL CALLS ***
+ ******************/
+
+static parameter_symbol *last_parameter(symbol *proc) {
+    if (proc->tag == SYM_PROC) {
+        return proc->get_procedure_symbol()->last_parameter;
+    }
+    if (proc->tag == SYM_FUNC) {
+        return proc->get_function_symbol()->last_parameter;
+    }
+    return NULL;
+}
+
+static int parameter_count(symbol *proc) {
+    int count = 0;
+    for (parameter_symbol *param = last_parameter(proc); param != NULL;
+         param = param->preceding) {
+        count++;
+    }
+    return count;
+}
+
+/* True if there is nothing but labels from the start of a block to the end
+   of the procedure. */
+static bool falls_to_end(control_flow_graph *cfg, size_t nr) {
+    for (; nr < cfg->blocks.size(); nr++) {
+        for (size_t i = 0; i < cfg->blocks[nr]->quads.size(); i++) {
+            if (cfg->blocks[nr]->quads[i]->op_code != q_labl) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* True if the call at a position in a block is the last thing the procedure
+   does, and a function returns what the call returned. */
+static bool is_tail_call(control_flow_graph *cfg, basic_block *b, size_t pos) {
+    quadruple *call = b->quads[pos];
+    if (pos + 1 == b->quads.size()) {
+        return call->sym3 == NULL_SYM && falls_to_end(cfg, b->nr + 1);
+    }
+    if (pos + 2 != b->quads.size()) {
+        return false;
+    }
+
+    quadruple *next = b->quads[pos + 1];
+    if (next->op_code == q_ireturn || next->op_code == q_rreturn) {
+        return call->sym3 != NULL_SYM && next->sym2 == call->sym3;
+    }
+    if (next->op_code == q_jmp) {
+        return call->sym3 == NULL_SYM &&
+               falls_to_end(cfg, cfg->block_for_label(next->int1)->nr);
+    }
+    return false;
+}
+
+/* Find the positions of the q_param quads of a call with 'wanted' arguments
+   at a position in a block, the last parameter first. Arguments can contain
+   calls of their own, whose parameters are skipped. */
+static bool find_parameters(vector<quadruple *> &quads, size_t pos, int wanted,
+                            vector<size_t> &params) {
+    int skip = 0;
+    for (size_t i = pos; i-- > 0 && (int)params.size() < wanted;) {
+        quadruple *q = quads[i];
+        if (quad_is_call(q)) {
+            skip += q->int2;
+        } else if (q->op_code == q_param) {
+            if (skip > 0) {
+                skip--;
+            } else {
+                params.push_back(i);
+            }
+        }
+    }
+    return (int)params.size() == wanted;
+}
+
+/* Calls that are the last thing a procedure does need no frame of their own.
+   A call to the procedure itself becomes a jump back to the start, after
+   assigning the arguments to the parameters. Other calls become q_tcall,
+   which reuses the caller's frame and the parameter slots its caller set up.
+   That requires the callee to need no more parameter slots than we have,
+   and its display to be a part of ours (it isn't nested in us), which also
+   rules out the main program and the predefined procedures. */
+void quad_optimizer::tail_calls(control_flow_graph *cfg) {
+    symbol *env = cfg->env;
+    if (env->level == 0) {
+        return;
+    }
+
+    int start_label = -1;
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        basic_block *b = cfg->blocks[i];
+        size_t pos = b->quads.size();
+        while (pos > 0 && !quad_is_call(b->quads[pos - 1])) {
+            pos--;
+        }
+        if (pos-- == 0 || b->quads[pos]->op_code != q_call || !is_tail_call(cfg, b, pos)) {
+            continue;
+        }
+
+        quadruple *call = b->quads[pos];
+        symbol *callee = sym_tab->get_symbol(call->sym1);
+        vector<size_t> params;
+        if (!find_parameters(b->quads, pos, call->int2, params)) {
+            continue;
+        }
+
+        if (callee == env) {
+            if (start_label < 0) {
+                start_label = sym_tab->get_next_label();
+                vector<quadruple *> &entry = cfg->blocks[0]->quads;
+                entry.insert(entry.begin(),
+                             new quadruple(q_labl, start_label, NULL_SYM, NULL_SYM));
+                if (b == cfg->blocks[0]) {
+                    pos++;
+                    for (size_t j = 0; j < params.size(); j++) {
+                        params[j]++;
+                    }
+                }
+            }
+
+            // Arguments are saved where they were pushed, since they may
+            // depend on parameters assigned before them.
+            vector<quadruple *> assigns;
+            parameter_symbol *param = last_parameter(env);
+            for (size_t j = 0; j < params.size(); j++, param = param->preceding) {
+                quadruple *push = b->quads[params[j]];
+                sym_index temp = sym_tab->gen_temp_var(param->type);
+                quad_op_type copy = param->type == real_type ? q_rassign : q_iassign;
+                push->op_code = copy;
+                push->sym3 = push->int3 = temp;
+                assigns.push_back(
+                    new quadruple(copy, temp, NULL_SYM, sym_tab->lookup_symbol(param->id)));
+            }
+            b->quads.resize(pos);
+            b->quads.insert(b->quads.end(), assigns.begin(), assigns.end());
+            b->quads.push_back(new quadruple(q_jmp, start_label, NULL_SYM, NULL_SYM));
+            continue;
+        }
+
+        if (callee->level == 0 || callee->level > env->level || callee->tag != env->tag ||
+            (env->tag == SYM_FUNC && callee->type != env->type) ||
+            parameter_count(callee) > parameter_count(env)) {
+            continue;
+        }
+        b->quads.resize(pos);
+        b->quads.push_back(new quadruple(q_tcall, call->sym1, call->int2, cfg->last_label));
+    }
+}
+
+/****************
+ *** INLINING ***
+ ****************/
+
+/* Keep a copy of the optimized quads of a procedure if it can be inlined:
+   it must be small, must not call itself or end in a tail call, and must
+   not have arrays or procedures of its own, which need its own frame. */
+void quad_optimizer::record_inline_body(control_flow_graph *cfg) {
+    symbol *env = cfg->env;
+    if (env->level == 0) {
+        return;
+    }
+
+    int size = 0;
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        for (size_t j = 0; j < cfg->blocks[i]->quads.size(); j++) {
+            quadruple *q = cfg->blocks[i]->quads[j];
+            if (q->op_code == q_tcall) {
+                return;
+            }
+            if (quad_is_call(q)) {
+                symbol *callee = sym_tab->get_symbol(q->sym1);
+                if (callee == env || callee->level > env->level) {
+                    return;
+                }
+            }
+            sym_index syms[4];
+            int n = quad_operands(q, syms);
+            syms[n++] = quad_definition(q);
+            for (int k = 0; k < n; k++) {
+                if (syms[k] != NULL_SYM && sym_tab->get_symbol_tag(syms[k]) == SYM_ARRAY &&
+                    cfg->is_local(syms[k])) {
+                    return;
+                }
+            }
+            if (q->op_code != q_labl) {
+                size++;
+            }
+        }
+    }
+    if (size > INLINE_SIZE_LIMIT) {
+        return;
+    }
+
+    inline_body &body = inline_bodies[env];
+    body.size = size;
+    body.end_label = cfg->last_label;
+    for (parameter_symbol *param = last_parameter(env); param != NULL;
+         param = param->preceding) {
+        body.parameters.push_back(sym_tab->lookup_symbol(param->id));
+    }
+    body.symbols = body.parameters;
+    set<sym_index> own(body.parameters.begin(), body.parameters.end());
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        for (size_t j = 0; j < cfg->blocks[i]->quads.size(); j++) {
+            quadruple *q = cfg->blocks[i]->quads[j];
+            body.quads.push_back(new quadruple(*q));
+
+            sym_index syms[4];
+            int n = quad_operands(q, syms);
+            syms[n++] = quad_definition(q);
+            for (int k = 0; k < n; k++) {
+                if (syms[k] != NULL_SYM && cfg->is_local(syms[k]) &&
+                    own.insert(syms[k]).second) {
+                    body.symbols.push_back(syms[k]);
+                }
+            }
+        }
+    }
+}
+
+/* Replace calls to procedures with a recorded body by a copy of the body.
+   The callee's parameters, variables and temporaries become temporaries of
+   the caller, and its labels new labels. Everything else the callee uses is
+   declared outside of it, at a level the caller's display has the same
+   frame for as the callee's would (the callee can't be nested deeper than
+   one level below the caller), so it can be used as it is.
+
+   Symbols are never removed from the table, so the temporaries made for
+   the copies are shared by them. Nothing of a callee's scope is live once
+   its copy is left, so a copy can use a temporary of another one that
+   ended before the copy's arguments are assigned. The arguments of a call
+   are computed between its pushes, so a copy among the arguments of
+   another call doesn't end early enough, and the outer copy gets other
+   temporaries. Inlining stops before the table gets too full for the rest
+   of the program. */
+void quad_optimizer::inline_calls(control_flow_graph *cfg) {
+    // The temporaries made for copies, and where the last copy using each
+    // ended.
+    struct inline_temporary {
+        sym_index sym;
+        size_t block;
+        size_t end;
+    };
+    vector<inline_temporary> temporaries;
+
+    int growth = 0;
+    for (size_t i = 0; i < cfg->blocks.size(); i++) {
+        basic_block *b = cfg->blocks[i];
+        vector<quadruple *> out;
+        for (size_t j = 0; j < b->quads.size(); j++) {
+            quadruple *call = b->quads[j];
+            if (call->op_code != q_call) {
+                out.push_back(call);
+                continue;
+            }
+            symbol *callee = sym_tab->get_symbol(call->sym1);
+            map<symbol *, inline_body>::iterator it = inline_bodies.find(callee);
+            vector<size_t> params;
+            if (it == inline_bodies.end() || growth + it->second.size > INLINE_GROWTH_LIMIT ||
+                !find_parameters(out, out.size(), call->int2, params)) {
+                out.push_back(call);
+                continue;
+            }
+            inline_body &body = it->second;
+
+            size_t first = out.size();
+            for (size_t k = 0; k < params.size(); k++) {
+                first = min(first, params[k]);
+            }
+            map<sym_index, sym_index> renames;
+            vector<size_t> used;
+            vector<bool> taken(temporaries.size(), false);
+            vector<sym_index> missing;
+            for (size_t k = 0; k < body.symbols.size(); k++) {
+                sym_index type = sym_tab->get_symbol_type(body.symbols[k]);
+                size_t t = 0;
+                while (t < temporaries.size() &&
+                       (taken[t] || sym_tab->get_symbol_type(temporaries[t].sym) != type ||
+                        (temporaries[t].block == i && temporaries[t].end > first))) {
+                    t++;
+                }
+                if (t == temporaries.size()) {
+                    missing.push_back(body.symbols[k]);
+                    continue;
+                }
+                taken[t] = true;
+                used.push_back(t);
+                renames[body.symbols[k]] = temporaries[t].sym;
+            }
+            int room = sym_tab->get_symbol_count() - first_symbol + missing.size();
+            if (first_symbol + room > INLINE_SYMBOL_LIMIT) {
+                out_of_symbols = true;
+                out.push_back(call);
+                continue;
+            }
+            symbol_room = max(symbol_room, room);
+            for (size_t k = 0; k < missing.size(); k++) {
+                inline_temporary temp;
+                temp.sym = sym_tab->gen_temp_var(sym_tab->get_symbol_type(missing[k]));
+                used.push_back(temporaries.size());
+                temporaries.push_back(temp);
+                renames[missing[k]] = temp.sym;
+            }
+            growth += body.size;
+
+            // The arguments are assigned to the parameters where they were
+            // pushed.
+            for (size_t k = 0; k < params.size(); k++) {
+                sym_index param = body.parameters[k];
+                sym_index temp = renames[param];
+                quadruple *push = out[params[k]];
+                push->op_code = sym_tab->get_symbol_type(param) == real_type ? q_rassign
+                                                                              : q_iassign;
+                push->sym3 = push->int3 = temp;
+            }
+
+            map<long, long> labels;
+            labels[body.end_label] = sym_tab->get_next_label();
+            for (size_t k = 0; k < body.quads.size(); k++) {
+                quadruple *q = new quadruple(*body.quads[k]);
+
+                // The symbols of the callee's own scope are renamed.
+                sym_index syms[4];
+                int n = quad_operands(q, syms);
+                syms[n++] = quad_definition(q);
+                for (int l = 0; l < n; l++) {
+                    symbol *sym = sym_tab->get_symbol(syms[l]);
+                    if (syms[l] != NULL_SYM && !renames.count(syms[l]) &&
+                        (sym->tag == SYM_VAR || sym->tag == SYM_PARAM) &&
+                        sym->level == callee->level + 1) {
+                        renames[syms[l]] = sym_tab->gen_temp_var(sym->type);
+                    }
+                }
+                rename_operands(q, renames);
+                sym_index def = quad_definition(q);
+                if (def != NULL_SYM && renames.count(def)) {
+                    q->sym3 = q->int3 = renames[def];
+                }
+
+                if (q->op_code == q_labl || q->op_code == q_jmp || q->op_code == q_jmpf ||
+                    q->op_code == q_jmpt || q->op_code == q_ireturn ||
+                    q->op_code == q_rreturn) {
+                    if (!labels.count(q->int1)) {
+                        labels[q->int1] = sym_tab->get_next_label();
+                    }
+                    q->sym1 = q->int1 = labels[q->int1];
+                }
+
+                // A return assigns the call's result and leaves the body.
+                if (q->op_code == q_ireturn || q->op_code == q_rreturn) {
+                    quad_op_type copy = q->op_code == q_rreturn ? q_rassign : q_iassign;
+                    out.push_back(new quadruple(copy, q->sym2, NULL_SYM, call->sym3));
+                    q->op_code = q_jmp;
+                    q->sym2 = q->int2 = NULL_SYM;
+                }
+                out.push_back(q);
+            }
+
+            for (size_t k = 0; k < used.size(); k++) {
+                temporaries[used[k]].block = i;
+                temporaries[used[k]].end = out.size();
+            }
+
+            if (print_inlining) {
+                cout << "Inlined \"" << sym_tab->pool_lookup(callee->id) << "\" into \""
+                     << sym_tab->pool_lookup(cfg->env->id) << "\" (" << body.size
+                     << " quads)" << endl;
+            }
+        }
+        b->quads = out;
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef __QUADOPT_HH__
+#define __QUADOPT_HH__
+
+#include "quads.hh"
+#include "cfg.hh"
+
+/* The quad optimizer. Where the ast_optimizer in optimize.hh folds constant
+   expressions in the AST, this class works on the quad list of a block
+   (the main program, a procedure or a function) after quad generation and
+   before assembler generation. The passes are built on the control flow
+   graph and dataflow analyses in cfg.hh. */
+class quad_optimizer {
+private:
+    // The quads of a procedure that can be inlined, with what is needed to
+    // rename its parameters and its labels. The parameters are listed in
+    // the order of the q_param quads of a call, the last one first. The
+    // symbols are those of its own scope, the parameters included, which
+    // are renamed to temporaries of the caller.
+    struct inline_body {
+        vector<quadruple *> quads;
+        vector<sym_index> parameters;
+        vector<sym_index> symbols;
+        int end_label;
+        int size;
+    };
+    map<symbol *, inline_body> inline_bodies;
+
+    // The cache keys of the blocks optimized so far, see codecache.hh.
+    map<symbol *, string> block_keys;
+
+    // The symbol count when the current block's optimization started, and
+    // how many symbols past it the inliner has needed room for.
+    sym_index first_symbol;
+    int symbol_room;
+
+    // Set when the inliner has run out of room in the symbol table. The
+    // optimization of a block then depends on more than its cache key.
+    bool out_of_symbols;
+
+    // Run the passes on a block.
+    void run_passes(quad_list *, symbol *);
+
+    // Record what is needed of a block once it is optimized, see
+    // optimize(). Arg 2 is the symbol table index of cfg->env.
+    void record_block(control_flow_graph *, sym_index);
+
+    // Replace calls to small procedures by their bodies.
+    void inline_calls(control_flow_graph *);
+
+    // Remember the body of an optimized procedure if it can be inlined.
+    void record_inline_body(control_flow_graph *);
+
+    // Turn calls that end a procedure into jumps.
+    void tail_calls(control_flow_graph *);
+
+    // Sparse conditional constant propagation: propagate constants through
+    // variables, resolve branches on known conditions and remove the quads
+    // of blocks that can't be reached.
+    void propagate_constants(control_flow_graph *);
+
+    // Value numbering over the dominator tree, removing recomputations of
+    // expressions (including array addresses) whose value is still around.
+    void value_numbering(control_flow_graph *);
+
+    // Remove quads whose results are never read, including stores to
+    // variables that are overwritten first, unreachable code, and the jumps
+    // and labels that are no longer needed.
+    void eliminate_dead_code(control_flow_graph *);
+
+    // Leave the variables and temporaries that are no longer used out of
+    // the activation record. Arg 2 is the symbol table index of cfg->env.
+    void compact_frame(control_flow_graph *, sym_index);
+
+    // A transformation of a single loop. Returns true if the graph was
+    // changed, in which case it is written back to the quad list.
+    typedef bool (quad_optimizer::*loop_transformation)(control_flow_graph *,
+                                                       natural_loop *);
+
+    // Apply a loop transformation to all loops, innermost first.
+    void transform_loops(quad_list *, symbol *, loop_transformation);
+
+    // Loop-invariant code motion: move what is computed the same way in
+    // every iteration to a new preheader block in front of the loop.
+    bool hoist_invariants(control_flow_graph *, natural_loop *);
+
+    // Strength reduction of array indexing by induction variables.
+    bool reduce_induction_variables(control_flow_graph *, natural_loop *);
+
+public:
+    quad_optimizer();
+
+    // Optimize a quad list in place. Arg 2 is the symbol table index of the
+    // block's environment.
+    void optimize(quad_list *, sym_index);
+};
+
+extern thread_local quad_optimizer *quad_opt;
+
+#endif
@@ -4,6 +4,7 @@
 #include "symtab.hh"
 #include "ast.hh"
 #include "quads.hh"
+#include "counters.hh"
 using namespace std;
 
 /* This little #define is only here to suppress compiler warnings for methods
@@ -25,6 +26,7 @@ quadruple::quadruple(quad_op_type op, long a1, long a2, long a3)
     , int1(a1)
     , int2(a2)
     , int3(a3) {
+    COUNT(quads[op]);
 }
 
 /* The quad_list_element constructor. Not very exciting really. This class
@@ -121,7 +123,7 @@ sym_index ast_integer::generate_quads(quad_list &q) {
 
 sym_index ast_real::generate_quads(quad_list &q) {
     sym_index sym_p = sym_tab->gen_temp_var(real_type);
-    q += new quadruple(q_rload, value, NULL_SYM, sym_p);
+    q += new quadruple(q_rload, sym_tab->ieee(value), NULL_SYM, sym_p);
     return sym_p;
 }
 
@@ -216,6 +218,57 @@ sym_index ast_and::generate_quads(quad_list &q) {
     return bin_op_quads(q, safe_binop(this), q_iand, q_nop);
 }
 
+/* Conditions. When an expression is only used to decide where to jump, as
+   in if, elsif and while, there is no need to build a boolean value for and,
+   or and not. Instead they are lowered into chains of conditional jumps,
+   which means the right operand is never evaluated (so any function calls
+   in it are never made) when the left operand already decides the result.
+   The sense argument tells whether to jump to the label when the condition
+   is true or when it is false; the other case falls through. */
+void ast_expression::generate_branch(quad_list &q, int label, bool sense) {
+    sym_index cond = generate_quads(q);
+    q += new quadruple(sense ? q_jmpt : q_jmpf, label, cond, NULL_SYM);
+}
+
+void ast_integer::generate_branch(quad_list &q, int label, bool sense) {
+    // A constant condition either always or never jumps.
+    if ((value != 0) == sense) {
+        q += new quadruple(q_jmp, label, NULL_SYM, NULL_SYM);
+    }
+}
+
+void ast_not::generate_branch(quad_list &q, int label, bool sense) {
+    expr->generate_branch(q, label, !sense);
+}
+
+void ast_and::generate_branch(quad_list &q, int label, bool sense) {
+    if (!sense) {
+        // Either operand being false is enough to take the jump.
+        left->generate_branch(q, label, false);
+        right->generate_branch(q, label, false);
+    } else {
+        // Both must be true. If the left one is false we skip the right.
+        int skip = sym_tab->get_next_label();
+        left->generate_branch(q, skip, false);
+        right->generate_branch(q, label, true);
+        q += new quadruple(q_labl, skip, NULL_SYM, NULL_SYM);
+    }
+}
+
+void ast_or::generate_branch(quad_list &q, int label, bool sense) {
+    if (sense) {
+        // Either operand being true is enough to take the jump.
+        left->generate_branch(q, label, true);
+        right->generate_branch(q, label, true);
+    } else {
+        // Both must be false. If the left one is true we skip the right.
+        int skip = sym_tab->get_next_label();
+        left->generate_branch(q, skip, true);
+        right->generate_branch(q, label, false);
+        q += new quadruple(q_labl, skip, NULL_SYM, NULL_SYM);
+    }
+}
+
 ast_binaryrelation *safe_binrel(ast_expression *expr) {
     auto bin = dynamic_cast<ast_binaryrelation *>(expr);
     if (!bin) {
@@ -337,16 +390,16 @@ sym_index ast_while::generate_quads(quad_list &q) {
     // Here's the label for the top of the while body.
     q += new quadruple(q_labl, top, NULL_SYM, NULL_SYM);
 
-    // Generate quads for the condition. After this code is being run, we
-    // check if the result in the variable stored in 'pos' is 0. If it is,
-    // we want to exit the loop, which is done via a conditional jump to the
+    // Generate quads for the condition. If it turns out to be false we
+    // want to exit the loop, which is done via a conditional jump to the
     // 'bottom' label.
-    sym_index pos = condition->generate_quads(q);
-    q += new quadruple(q_jmpf, bottom, pos, NULL_SYM);
+    condition->generate_branch(q, bottom, false);
 
     // Generate quads for the body. Following these come an unconditional
     // jump to the 'top' label, ie, run the condition etc again.
-    pos = body->generate_quads(q);
+    if (body) {
+        body->generate_quads(q);
+    }
     q += new quadruple(q_jmp, top, NULL_SYM, NULL_SYM);
 
     // This is where we jump to if the while condition evaluates to false.
@@ -366,8 +419,7 @@ sym_index ast_elsif::generate_quads(quad_list &q) {
 void ast_elsif::generate_quads_and_jump(quad_list &q, int label) {
     int label_elsif = sym_tab->get_next_label();
 
-    sym_index cond_res = condition->generate_quads(q);
-    q += new quadruple(q_jmpf, label_elsif, cond_res, NULL_SYM);
+    condition->generate_branch(q, label_elsif, false);
 
     if (body) {
         body->generate_quads(q);
@@ -392,10 +444,10 @@ sym_index ast_if::generate_quads(quad_list &q) {
     int label_elsif = sym_tab->get_next_label();
     int label_after = sym_tab->get_next_label();
     int label_else = sym_tab->get_next_label();
-    sym_index cond_res = condition->generate_quads(q);
-
-    q += new quadruple(q_jmpf, label_elsif, cond_res, NULL_SYM);
-    body->generate_quads(q);
+    condition->generate_branch(q, label_elsif, false);
+    if (body) {
+        body->generate_quads(q);
+    }
     q += new quadruple(q_jmp, label_after, NULL_SYM, NULL_SYM);
 
     q += new quadruple(q_labl, label_elsif, NULL_SYM, NULL_SYM);
@@ -684,6 +736,12 @@ void quadruple::print(ostream &o) {
           << setw(11) << int2
           << setw(11) << sym_tab->get_symbol(sym3);
         break;
+    case q_tcall:
+        o << setw(11) << "q_tcall"
+          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << int2
+          << setw(11) << int3;
+        break;
     case q_rreturn:
         o << setw(11) << "q_rreturn"
           << setw(11) << int1
@@ -714,6 +772,18 @@ void quadruple::print(ostream &o) {
           << setw(11) << sym_tab->get_symbol(sym2)
           << setw(11) << sym_tab->get_symbol(sym3);
         break;
+    case q_rfetch:
+        o << setw(11) << "q_rfetch"
+          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << "-"
+          << setw(11) << sym_tab->get_symbol(sym3);
+        break;
+    case q_ifetch:
+        o << setw(11) << "q_ifetch"
+          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << "-"
+          << setw(11) << sym_tab->get_symbol(sym3);
+        break;
     case q_itor:
         o << setw(11) << "q_itor"
           << setw(11) << sym_tab->get_symbol(sym1)
@@ -732,6 +802,12 @@ void quadruple::print(ostream &o) {
           << setw(11) << sym_tab->get_symbol(sym2)
           << setw(11) << "-";
         break;
+    case q_jmpt:
+        o << setw(11) << "q_jmpt"
+          << setw(11) << int1
+          << setw(11) << sym_tab->get_symbol(sym2)
+          << setw(11) << "-";
+        break;
     case q_param:
         o << setw(11) << "q_param"
           << setw(11) << sym_tab->get_symbol(sym1)
@@ -40,14 +40,18 @@ typedef enum {
     q_rassign, // sym, -, sym
     q_iassign, // sym, -, sym
     q_call,    // sym, int, sym (or - if a procedure)
+    q_tcall,   // sym, int, int
     q_rreturn, // int, sym, -
     q_ireturn, // int, sym, -
     q_lindex,  // sym, sym, sym
     q_rrindex, // sym, sym, sym
     q_irindex, // sym, sym, sym
+    q_rfetch,  // sym, -, sym
+    q_ifetch,  // sym, -, sym
     q_itor,    // sym, -, sym
     q_jmp,     // int, -, -
     q_jmpf,    // int, sym, -
+    q_jmpt,    // int, sym, -
     q_param,   // sym, -, -
     q_labl,    // int, -, -
     q_nop,     // -, -, -
@@ -142,6 +146,7 @@ public:
 
     // Allow the iterator access to private data fields in this class.
     friend class quad_list_iterator;
+    friend class control_flow_graph;
     friend ostream &operator<<(ostream &, quad_list *);
 };
 
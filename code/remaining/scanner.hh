@@ -1,6 +1,8 @@
 #ifndef __SCANNER_HH__
 #define __SCANNER_HH__
 
+#include <stdio.h>
+
 #include "symtab.hh"
 
 typedef union {
@@ -74,11 +76,22 @@ typedef struct {
 #define NR_SYMS 83 // Total no. of grammar symbols
 
 /*!
-  Contains the additional attributes needed to describe certain tokens
-  (integers, reals, string constants, and identifiers).
+  The scanner is reentrant. Its state is kept in a handle, which is created
+  by yylex_init() and given to the other functions.
+  */
+typedef void *yyscan_t;
+
+extern int yylex_init(yyscan_t *);
+extern int yylex_destroy(yyscan_t);
+extern void yyset_in(FILE *, yyscan_t);
+extern char *yyget_text(yyscan_t);
+
+/*!
+  Returns the next token. The additional attributes needed to describe
+  certain tokens (integers, reals, string constants, and identifiers) are
+  stored in the first argument, and their position in the source code in
+  the second.
   */
-extern YYSTYPE yylval;
-//! Contains variables for tracking position in the source code.
-extern YYLTYPE yylloc;
+extern int yylex(YYSTYPE *, YYLTYPE *, yyscan_t);
 
 #endif
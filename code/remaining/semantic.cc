@@ -1,12 +1,14 @@
 #include "semantic.hh"
 
-semantic *type_checker = new semantic();
+// Set by compilation_context::activate(), see context.hh.
+thread_local semantic *type_checker = NULL;
 
 /* Used to check that all functions contain return statements.
-   Static means that it is only visible inside this file.
+   Static means that it is only visible inside this file, and thread_local
+   that every thread type checking a block has its own.
    It is set to false in do_typecheck() (ie, every time we start type checking
    a new block) and set to true if we find an ast_return node. See below. */
-static bool has_return = false;
+static thread_local bool has_return = false;
 
 /* Interface for type checking a block of code represented as an AST node. */
 void semantic::do_typecheck(symbol *env, ast_stmt_list *body) {
@@ -312,7 +314,9 @@ sym_index ast_if::type_check() {
     if (condition->type_check() != integer_type) {
         type_error(condition->pos) << "Not an integer vaule in if" << endl;
     }
-    body->type_check();
+    if (body != NULL) {
+        body->type_check();
+    }
     if (elsif_list != NULL) {
         elsif_list->type_check();
     }
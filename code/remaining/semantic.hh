@@ -6,7 +6,7 @@
 class semantic;
 
 // Defined in semantic.cc.
-extern semantic *type_checker;
+extern thread_local semantic *type_checker;
 
 class semantic {
 public:
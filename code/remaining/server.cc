@@ -0,0 +1,162 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "error.hh"
+#include "context.hh"
+#include "protocol.hh"
+#include "driver.hh"
+#include "server.hh"
+
+using namespace std;
+
+compile_server::compile_server(const string socket_name, const string glue_name)
+    : socket_path(socket_name) {
+    if (!read_whole_file(glue_name, glue)) {
+        error() << "Could not open " << glue_name << endl;
+        exit(1);
+    }
+}
+
+/* Turn the flags of a request into compile options and cpp options, the
+   way main.cc and the diesel script do. Only the flags that change the
+   code are allowed; the ones printing things would print on the server's
+   stdout. Returns false for anything else. */
+static bool parse_flags(const vector<string> &args, compile_options &options,
+                        vector<string> &cpp_options, ostream &messages) {
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        const string &flag = args[i];
+        if (flag == "-c") {
+            options.typecheck = false;
+        } else if (flag == "-f") {
+            options.optimize = false;
+        } else if (flag == "-p") {
+            options.quads = false;
+        } else if (flag == "-s") {
+            options.assembler = false;
+        } else if (flag == "-t") {
+            options.assembler_trace = true;
+        } else if (flag == "-w") {
+            options.whole_program = true;
+        } else if (flag == "-C" && i + 2 < args.size()) {
+            options.cache_directory = args[++i];
+        } else if (flag.compare(0, 2, "-I") == 0 || flag.compare(0, 2, "-D") == 0
+                   || flag.compare(0, 2, "-U") == 0) {
+            cpp_options.push_back(flag);
+        } else {
+            messages << "Option not supported by the compile server: " << flag
+                     << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Returns the exit status the compiler would have had: the number of errors,
+   or 1 if the program couldn't be compiled at all. */
+int compile_server::compile(const vector<string> &args, string &code,
+                            string &messages) {
+    ostringstream code_stream;
+    ostringstream message_stream;
+    compile_options options;
+    vector<string> cpp_options;
+
+    code = "";
+    if (args.empty()) {
+        messages = "No source file.\n";
+        return 1;
+    }
+    if (!parse_flags(args, options, cpp_options, message_stream)) {
+        messages = message_stream.str();
+        return 1;
+    }
+
+    // The preprocessor prints its errors through error(), like the
+    // compiler, so they are sent back too.
+    string source;
+    error_stream = &message_stream;
+    bool preprocessed = includes.preprocess(args.back(), cpp_options, source);
+    error_stream = &cerr;
+    if (!preprocessed) {
+        messages = message_stream.str();
+        return 1;
+    }
+    // fmemopen() can't open an empty buffer.
+    if (source.empty()) {
+        source = "\n";
+    }
+
+    FILE *in = fmemopen(&source[0], source.size(), "r");
+    if (in == NULL) {
+        messages = "Could not read the preprocessed program.\n";
+        return 1;
+    }
+    int errors;
+    {
+        compilation_context context(options, code_stream, message_stream);
+        errors = context.compile(in);
+    }
+    fclose(in);
+
+    if (errors == 0 && !code_stream.str().empty()) {
+        code = glue + code_stream.str();
+    }
+    messages = message_stream.str();
+    return errors;
+}
+
+void compile_server::serve(int connection) {
+    vector<string> args;
+    while (receive_request(connection, args)) {
+        string code;
+        string messages;
+        int status = compile(args, code, messages);
+        if (!send_reply(connection, status, code, messages)) {
+            break;
+        }
+    }
+    close(connection);
+}
+
+void compile_server::run() {
+    struct sockaddr_un address;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        error() << "Socket path too long: " << socket_path << endl;
+        return;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return;
+    }
+    unlink(socket_path.c_str());
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0
+        || listen(listener, 64) < 0) {
+        perror(socket_path.c_str());
+        close(listener);
+        return;
+    }
+
+    // A client going away in the middle of a reply isn't our problem.
+    signal(SIGPIPE, SIG_IGN);
+
+    cout << "Compile server listening on " << socket_path << endl;
+    for (;;) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) {
+            continue;
+        }
+        thread(&compile_server::serve, this, connection).detach();
+    }
+}
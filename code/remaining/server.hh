@@ -0,0 +1,43 @@
+#ifndef __SERVER_HH__
+#define __SERVER_HH__
+
+#include <string>
+#include <vector>
+
+#include "preprocess.hh"
+
+using namespace std;
+
+/* A compile server (the -S flag). Instead of starting the compiler, and
+   cpp twice, for every program, the compiler is started once and listens
+   on a Unix domain socket. A client, such as dieselc, sends the flags and
+   the name of a source file (see protocol.hh) and gets the assembler code
+   back. What doesn't depend on the program is kept between requests: the
+   included files (stdio.d and the like) and diesel_glue.s. Every
+   connection is served by a thread of its own, and every program gets a
+   compilation_context of its own, so programs are compiled at the same
+   time. */
+class compile_server {
+private:
+    string socket_path;
+
+    // The contents of diesel_glue.s, which starts every assembler file.
+    string glue;
+
+    preprocessor includes;
+
+    // Serve the requests coming on a connection, until it is closed.
+    void serve(int);
+
+    // Compile a program. Arg 1 is the request, the rest is the reply.
+    int compile(const vector<string> &, string &, string &);
+
+public:
+    //! Arg 1 = path of the socket, arg 2 = path of diesel_glue.s.
+    compile_server(const string, const string);
+
+    //! Accept connections. Only returns if the socket couldn't be set up.
+    void run();
+};
+
+#endif
@@ -10,6 +10,9 @@ symbol::symbol(pool_index pool_p) {
     // All symbols are tagged as SYM_UNDEF at creation.
     // This is used later to check for redeclarations.
     tag = SYM_UNDEF;
+    // Only variables, arrays and parameters get a real offset, but the
+    // symbol table printout shows it for every symbol.
+    offset = 0;
 }
 
 /* Constructor for constant_symbol. Note the somewhat weird syntax for
@@ -72,7 +75,7 @@ nametype_symbol::nametype_symbol(const pool_index pool_p)
 
 // This is the default detail level of information given when printing a
 // symbol.
-symbol::format_type symbol::output_format = symbol::LONG_FORMAT;
+thread_local symbol::format_type symbol::output_format = symbol::LONG_FORMAT;
 
 /* Prints information common to all symbols. The various subclasses add on
    their own info to this one, see below. */
@@ -7,16 +7,20 @@
 #include <ctype.h>
 #include <string.h>
 #include "symtab.hh"
+#include "counters.hh"
 
 using namespace std;
 
 /*** Global variables ***/
 
-// The symbol table is a table of pointers to symbol (which can be of various types)
-symbol_table *sym_tab = new symbol_table();
-sym_index void_type;
-sym_index integer_type;
-sym_index real_type;
+// The symbol table is a table of pointers to symbol (which can be of various
+// types). In the compiler it belongs to the compilation running on the
+// thread, see context.hh, while the labs just use one.
+#if defined(LAB1) || defined(LAB2)
+thread_local symbol_table *sym_tab = new symbol_table();
+#else
+thread_local symbol_table *sym_tab = NULL;
+#endif
 
 /*** The symbol_table class - watch out, it's big. ***/
 
@@ -85,18 +89,18 @@ symbol_table::symbol_table() {
         throw std::logic_error("Failed to install symbol");
     }
     // Needed since there have been no types installed yet.
-    sym_table[0]->type = void_type;
+    sym_table[0]->type = 0;
 
     // Install the default nametypes. This is the only place enter_nametype()
     // is used, since currently Diesel's grammar doesn't handle used-defined
-    // types.
+    // types. They must get the indexes given in symtab.hh.
 
-    void_type = enter_nametype(dummy_pos, pool_install(capitalize("void")));
-    sym_table[void_type]->type = void_type; // Needed since it's the first one.
-
-    integer_type = enter_nametype(dummy_pos, pool_install(capitalize("integer")));
-
-    real_type = enter_nametype(dummy_pos, pool_install(capitalize("real")));
+    sym_index void_nr = enter_nametype(dummy_pos, pool_install(capitalize("void")));
+    sym_index integer_nr = enter_nametype(dummy_pos, pool_install(capitalize("integer")));
+    sym_index real_nr = enter_nametype(dummy_pos, pool_install(capitalize("real")));
+    if (void_nr != void_type || integer_nr != integer_type || real_nr != real_type) {
+        throw std::logic_error("Failed to install the predefined types");
+    }
 
     {
         // Add the read() function. It returns an integer and takes no arguments.
@@ -135,6 +139,44 @@ symbol_table::symbol_table() {
     par->offset = 0;
     truc->get_function_symbol()->last_parameter = par;
 
+    // The number I/O of stdio.d, done natively by diesel_rts.c. They print
+    // and read numbers the way the Diesel routines do, but without a call
+    // per digit. A program declaring its own (like stdio.d does) hides them.
+    // The parameters need the same workaround as trunc's, and their names
+    // must differ from the other parameters at this level.
+    {
+        sym_index write_int_sym =
+            enter_procedure(dummy_pos, pool_install(capitalize("write_int")));
+        sym_index arg = enter_parameter(dummy_pos,
+                                        pool_install(capitalize("int-value")),
+                                        integer_type);
+        parameter_symbol *arg_par = sym_table[arg]->get_parameter_symbol();
+        arg_par->preceding = NULL;
+        arg_par->offset = 0;
+        sym_table[write_int_sym]->get_procedure_symbol()->last_parameter = arg_par;
+    }
+    {
+        sym_index write_real_sym =
+            enter_procedure(dummy_pos, pool_install(capitalize("write_real")));
+        sym_index arg = enter_parameter(dummy_pos,
+                                        pool_install(capitalize("real-value")),
+                                        real_type);
+        parameter_symbol *arg_par = sym_table[arg]->get_parameter_symbol();
+        arg_par->preceding = NULL;
+        arg_par->offset = 0;
+        sym_table[write_real_sym]->get_procedure_symbol()->last_parameter = arg_par;
+    }
+    {
+        sym_index read_int_sym =
+            enter_function(dummy_pos, pool_install(capitalize("read_int")));
+        sym_table[read_int_sym]->type = integer_type;
+    }
+    {
+        sym_index read_real_sym =
+            enter_function(dummy_pos, pool_install(capitalize("read_real")));
+        sym_table[read_real_sym]->type = real_type;
+    }
+
     sym_table[0]->get_procedure_symbol()->last_parameter = NULL;
 }
 
@@ -176,10 +218,22 @@ sym_index symbol_table::gen_temp_var(sym_index type) {
     if (temp_nr > MAX_TEMP_VARS) {
         fatal("Cannot compile this much code! :<");
     }
+    COUNT(temporaries);
     auto id = pool_install(const_cast<char *>(temp_name.c_str()));
     return enter_variable(NULL, id, type);
 }
 
+/* Temporaries are the only symbols whose names start with a '$', since the
+   scanner never accepts that character in an identifier. The first byte of a
+   pool entry holds its length, so the name starts one byte in. */
+bool symbol_table::is_temp_var(const sym_index sym_p) {
+    if (sym_p == NULL_SYM || sym_table[sym_p]->tag != SYM_VAR) {
+        return false;
+    }
+
+    return string_pool[sym_table[sym_p]->id + 1] == '$';
+}
+
 /* This function returns the byte size of a nametype. */
 
 int symbol_table::get_size(const sym_index type) {
@@ -376,6 +430,7 @@ pool_index symbol_table::pool_install(char *s) {
     // Make sure pool is not full. If it is, double pool size.
     if (pool_pos + 1 + (int)strlen(s) >= pool_length) {
         char *tmp_pool = new char[2 * pool_length];
+        COUNT_ADD(pool_copied_bytes, pool_pos);
 
         // Double pool size.
         pool_length *= 2;
@@ -395,6 +450,8 @@ pool_index symbol_table::pool_install(char *s) {
         return 0;
     }
 
+    COUNT_ADD(pool_bytes, strlen(s) + 1);
+
     // First install the length of the string.
     string_pool[pool_pos++] = (unsigned char)strlen(s);
     string_pool[pool_pos] = '\0';
@@ -528,6 +585,11 @@ sym_index symbol_table::close_scope() {
 
     for (auto i = sym_pos; i > new_level; i--) {
         symbol *current_symbol = sym_table[i];
+        // Symbols of nested blocks were unlinked when those were closed.
+        // Temporaries can be made after that, so they may lie in between.
+        if (current_symbol->level > current_level + 1) {
+            continue;
+        }
         hash_table[current_symbol->back_link] = current_symbol->hash_link;
         current_symbol->hash_link = -1;
     }
@@ -541,9 +603,11 @@ sym_index symbol_table::close_scope() {
    follows hash links outwards. */
 sym_index symbol_table::lookup_symbol(const pool_index pool_p) {
     hash_index hash_i = hash(pool_p);
+    COUNT(lookups);
 
     sym_index entry = hash_table[hash_i];
     while (entry != NULL_SYM) {
+        COUNT(probes);
         symbol *sym_entry = sym_table[entry];
         if (pool_compare(sym_entry->id, pool_p)) {
             return entry;
@@ -563,6 +627,17 @@ symbol *symbol_table::get_symbol(const sym_index sym_p) {
     return sym_table[sym_p];
 }
 
+/* Symbols are never removed from the table, only unlinked from the hash
+   table when their scope is closed, so this covers closed scopes too. */
+sym_index symbol_table::get_symbol_count() {
+    return sym_pos + 1;
+}
+
+/* The labels are numbered from -1, see get_next_label(). */
+long symbol_table::get_label_count() {
+    return label_nr + 1;
+}
+
 /* Given a sym_index, we return the id field of the symbol. The scanner needs
    this information in order to treat already-installed identifiers properly
    if shared strings are implemented. */
@@ -97,14 +97,15 @@ class symbol_table;
  to reduce memory requirements, to look-up and identify symbols,
  as well as forget strings).
  */
-extern symbol_table *sym_tab; // implementation in symtab.cc
+extern thread_local symbol_table *sym_tab; // implementation in symtab.cc
 
 /* Global symbol table variables. These indexes point to symbols in the symbol
-   table which represent information about types. Declared "for real" in
-   symbol.cc. */
-extern sym_index void_type;
-extern sym_index integer_type;
-extern sym_index real_type;
+   table which represent information about types. Every symbol table enters
+   them right after the global level and in this order, so they are the same
+   for all of them. */
+const sym_index void_type = 1;
+const sym_index integer_type = 2;
+const sym_index real_type = 3;
 
 /**********************************
  *** THE VARIOUS SYMBOL CLASSES ***
@@ -134,7 +135,7 @@ protected:
 
     typedef enum format_types format_type;
 
-    static format_type output_format;
+    static thread_local format_type output_format;
 
 public:
     /*! \brief Index to the string_pool, ie, its name.
@@ -606,6 +607,12 @@ public:
 
     symbol *get_symbol(const sym_index);
 
+    //! The number of symbols installed so far. Valid indexes are below it.
+    sym_index get_symbol_count();
+
+    //! The number of labels generated so far by get_next_label().
+    long get_label_count();
+
     /*! \brief Installs a symbol in the symbol table and returns its index.
       This method installs a symbol in the symbol table and returns its
       index. If the symbol already existed at the same lexical level
@@ -732,6 +739,9 @@ public:
      */
     sym_index gen_temp_var(sym_index);
 
+    //! Returns true if the symbol is a temporary made by gen_temp_var().
+    bool is_temp_var(const sym_index);
+
     // These functions are used to enter identifiers into the symbol table,
     // depending on their context (function, constant, etc).
 
@@ -0,0 +1,178 @@
+#include <fstream>
+#include <sstream>
+
+#include "error.hh"
+#include "symtab.hh"
+#include "codegen.hh"
+#include "context.hh"
+#include "unit.hh"
+
+using namespace std;
+
+/* The linker of the compilation running on this thread. Set by
+   compilation_context::activate(). */
+thread_local unit_linker *linker = NULL;
+
+unit_linker::unit_linker()
+    : program(NULL_SYM) {
+}
+
+/* The type an interface file names, or NULL_SYM for an unknown one. */
+static sym_index type_named(const string &name) {
+    if (name == "integer") {
+        return integer_type;
+    } else if (name == "real") {
+        return real_type;
+    }
+    return NULL_SYM;
+}
+
+/* The name an interface file uses for a type. */
+static string type_name(sym_index type) {
+    return type == real_type ? "real" : "integer";
+}
+
+bool unit_linker::read_interface(const string &path) {
+    ifstream file(path.c_str());
+    if (!file) {
+        error() << "Could not open the interface " << path << endl;
+        return false;
+    }
+
+    string line;
+    for (int nr = 1; getline(file, line); nr++) {
+        istringstream words(line);
+        string kind;
+        if (!(words >> kind) || kind[0] == '#') {
+            continue;
+        }
+
+        routine_signature routine;
+        routine.is_function = kind == "function";
+        string param;
+        string type;
+        bool ok = (kind == "function" || kind == "procedure")
+                  && (words >> routine.name >> routine.global_name
+                            >> routine.result_type);
+        ok = ok && (routine.is_function ? type_named(routine.result_type) != NULL_SYM
+                                        : routine.result_type == "-");
+        while (ok && words >> param) {
+            ok = (words >> type) && type_named(type) != NULL_SYM;
+            routine.parameters.push_back(make_pair(param, type));
+        }
+        if (!ok) {
+            error() << path << ", line " << nr << ": not an interface line" << endl;
+            return false;
+        }
+        imports.push_back(routine);
+    }
+    return true;
+}
+
+/* The imported routines are entered in the program's scope the way the
+   parser enters a procedure or function head, so they are found like the
+   program's own. */
+void unit_linker::enter_imports(sym_index program_sym) {
+    program = program_sym;
+
+    position_information *pos = new position_information();
+    for (size_t i = 0; i < imports.size(); i++) {
+        routine_signature &routine = imports[i];
+        pool_index id = sym_tab->pool_install(sym_tab->capitalize(routine.name.c_str()));
+        sym_index sym_p = routine.is_function ? sym_tab->enter_function(pos, id)
+                                              : sym_tab->enter_procedure(pos, id);
+        sym_tab->open_scope();
+        for (size_t j = 0; j < routine.parameters.size(); j++) {
+            pair<string, string> &param = routine.parameters[j];
+            sym_tab->enter_parameter(pos,
+                                     sym_tab->pool_install(
+                                         sym_tab->capitalize(param.first.c_str())),
+                                     type_named(param.second));
+        }
+        sym_tab->close_scope();
+        if (routine.is_function) {
+            sym_tab->set_symbol_type(sym_p, type_named(routine.result_type));
+        }
+        imported.insert(sym_p);
+
+        symbol *sym = sym_tab->get_symbol(sym_p);
+        long label = sym->tag == SYM_FUNC ? sym->get_function_symbol()->label_nr
+                                          : sym->get_procedure_symbol()->label_nr;
+        if (quads && assembler) {
+            code_gen->import_label(label, routine.global_name);
+        }
+    }
+}
+
+string unit_linker::global_name(long label) {
+    ostringstream name;
+    name << sym_tab->pool_lookup(sym_tab->get_symbol(program)->id) << "_L" << label;
+    return name.str();
+}
+
+bool unit_linker::write_interface(const string &path) {
+    if (program == NULL_SYM) {
+        return false;
+    }
+    int level = sym_tab->get_symbol(program)->level + 1;
+
+    // What the unit declares at its top level, in the order it was declared.
+    vector<symbol *> routines;
+    bool ok = true;
+    for (sym_index i = 0; i < sym_tab->get_symbol_count(); i++) {
+        symbol *sym = sym_tab->get_symbol(i);
+        if (sym == NULL || sym->level != level) {
+            continue;
+        }
+        if ((sym->tag == SYM_VAR || sym->tag == SYM_ARRAY) && !sym_tab->is_temp_var(i)) {
+            error() << "A unit can't have global variables: "
+                    << sym_tab->pool_lookup(sym->id) << endl;
+            ok = false;
+        } else if ((sym->tag == SYM_PROC || sym->tag == SYM_FUNC) && !imported.count(i)) {
+            routines.push_back(sym);
+        }
+    }
+    if (!ok) {
+        return false;
+    }
+
+    ofstream file(path.c_str());
+    file << "# Diesel interface of " << sym_tab->pool_lookup(sym_tab->get_symbol(program)->id)
+         << "." << endl;
+    for (size_t i = 0; i < routines.size(); i++) {
+        symbol *sym = routines[i];
+        long label;
+        parameter_symbol *last_param;
+        if (sym->tag == SYM_FUNC) {
+            label = sym->get_function_symbol()->label_nr;
+            last_param = sym->get_function_symbol()->last_parameter;
+            file << "function " << sym_tab->pool_lookup(sym->id) << " "
+                 << global_name(label) << " " << type_name(sym->type);
+        } else {
+            label = sym->get_procedure_symbol()->label_nr;
+            last_param = sym->get_procedure_symbol()->last_parameter;
+            file << "procedure " << sym_tab->pool_lookup(sym->id) << " "
+                 << global_name(label) << " -";
+        }
+
+        // The parameters are linked from the last one.
+        vector<parameter_symbol *> params;
+        for (; last_param != NULL; last_param = last_param->preceding) {
+            params.insert(params.begin(), last_param);
+        }
+        for (size_t j = 0; j < params.size(); j++) {
+            file << " " << sym_tab->pool_lookup(params[j]->id) << " "
+                 << type_name(params[j]->type);
+        }
+        file << endl;
+
+        if (quads && assembler) {
+            code_gen->export_label(label, global_name(label));
+        }
+    }
+    if (!file) {
+        error() << "Could not write the interface " << path << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef __UNIT_HH__
+#define __UNIT_HH__
+
+#include <string>
+#include <vector>
+#include <set>
+
+#include "symtab.hh"
+
+using namespace std;
+
+/* Separate compilation. A unit is an ordinary Diesel program whose
+   procedures and functions are meant to be used by other programs. When it
+   is compiled with '-u interface', the signatures of the procedures and
+   functions declared directly in it are written to the interface file, and
+   its code is made into an object file (without diesel_glue.s) instead of
+   an executable. A program compiled with '-l interface' can then call them
+   as if they had been declared in it, and the object file is linked in by
+   giving it after the source.
+
+   The code of a block is reached through its label, L<label_nr>, which is
+   only unique within one compilation, and isn't visible outside the object
+   file. A unit therefore makes each of its procedures and functions
+   visible under the name of the unit, <unit>_L<label_nr>, and a program
+   importing it makes the label of the imported one an alias for that name,
+   so the linker connects the two. The code generator doesn't need to know
+   about any of this.
+
+   A unit's main program body is compiled, but never run, so its global
+   variables would have no frame. A unit therefore can't have any.
+
+   An interface file has a line for each procedure or function:
+
+       function  <name> <unit>_L<label> <result type> {<param> <type>}
+       procedure <name> <unit>_L<label> - {<param> <type>}
+
+   where the types are 'integer' or 'real', and the parameters are given in
+   the order they are declared. Lines starting with '#' are comments. */
+
+// A procedure or function read from an interface file.
+struct routine_signature {
+    bool is_function;
+    string name;
+    string global_name;
+    string result_type;
+    vector<pair<string, string> > parameters;
+};
+
+class unit_linker {
+private:
+    // Everything imported with -l.
+    vector<routine_signature> imports;
+
+    // The imported symbols, which the interface of a unit leaves out.
+    set<sym_index> imported;
+
+    // The main program, once the parser has seen its name.
+    sym_index program;
+
+    // The global name of a label in this unit.
+    string global_name(long);
+
+public:
+    unit_linker();
+
+    //! Read an interface file. Prints an error and returns false if it
+    //! couldn't be read.
+    bool read_interface(const string &);
+
+    //! Called by the parser when the program's scope has been opened. Arg =
+    //! the program. Enters the imported procedures and functions.
+    void enter_imports(sym_index);
+
+    //! Write the interface of the program, which has been compiled as a
+    //! unit, to the file in arg 1, and make its procedures and functions
+    //! visible to the linker. Prints an error and returns false if it
+    //! can't be used as a unit.
+    bool write_interface(const string &);
+};
+
+extern thread_local unit_linker *linker;
+
+#endif
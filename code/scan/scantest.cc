@@ -16,6 +16,7 @@ typedef struct {
 /*** Global variables ***/
 YYSTYPE yylval;
 YYLTYPE yylloc;
+yyscan_t scanner;
 
 /* List of all tokens. */
 token_name tokens[] = {
@@ -76,9 +77,7 @@ ostream &print_token(ostream &o, int token) {
     int i;
     double re; // variable used to printing yylval.rval
     long in;   // variable used to printing yylval.ival
-    extern char *yytext;
-    extern YYLTYPE yylloc;
-    extern YYSTYPE yylval; /* #change extern YYSTYPE yylval;*/
+    char *yytext = yyget_text(scanner);
     for (i = 0; i < nr_tokens; i++) {
 
         if (token == tokens[i].token) {
@@ -147,8 +146,7 @@ const Omanip_int Token(int t) {
    type and corresponding yytext is printed. */
 int main(int argc, char **argv) {
     int token;
-    extern FILE *yyin;
-    extern int yylex();
+    FILE *yyin;
 
     /* Open the input file, if any. */
     switch (argc) {
@@ -167,13 +165,18 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
+    yylex_init(&scanner);
+    yyset_in(yyin, scanner);
+
     /* Loop for as long as there are tokens */
 
-    while ((token = yylex()) != 0) {
+    while ((token = yylex(&yylval, &yylloc, scanner)) != 0) {
         cout << "Scanned " << Token(token) << '\n'
              << flush;
     }
 
+    yylex_destroy(scanner);
+
     cout << "End of file\n";
     exit(0);
 }